@@ -1,11 +1,19 @@
 #include <cstddef>
+#include <cstdlib>
 #include <cassert>
 #include <cstring>
-#include <memory>
 #include <iostream>
+#include <algorithm>
+#include <bit>
 
 #include "pager.h"
 #include "pager_utils.h"
+#include "pager_policy.h"
+#include "pager_swap.h"
+#include "pager_merge.h"
+#include "pager_zswap.h"
+#include "pager_fcb.h"
+#include "pager_super.h"
 
 uintptr_t ARENA_BASE = reinterpret_cast<uintptr_t>(VM_ARENA_BASEADDR);
 unsigned char* BASE_ADDR;
@@ -14,15 +22,42 @@ unsigned int MAX_PHYS_PAGES;
 
 pid_t current_pid;
 
-std::unordered_map<unsigned int, std::shared_ptr<phys_page_t>> page_map;
-std::queue<std::shared_ptr<phys_page_t>> clock_queue;
+std::vector<phys_page_t> frame_table;
+std::vector<phys_page_info_t> frame_info;
+std::vector<rmap_node_t> rmap_pool;
+unsigned int rmap_free = RMAP_NIL;
 std::unordered_map<pid_t, pcb_t> process_map;
-std::unordered_map<std::string, block_map> file_backed_pages;
+std::vector<std::string> file_names;
+std::unordered_map<std::string, unsigned int> file_ids;
+std::vector<fcb_t> fcb_pool;
+std::list<unsigned int> drop_behind_frames;
 std::unordered_set<unsigned int> open_phys_pages;
-std::unordered_set<unsigned int> open_swap_pages;
-std::vector<std::unordered_set<pid_t>> swap_file;
 
 int num_swap_block_available;
+unsigned int cleaner_hand = 0;
+unsigned int tracked_frames = 0;
+unsigned int reclaim_low;
+unsigned int reclaim_high;
+unsigned int reclaim_batch;
+
+// unsigned value of an environment variable, fallback if unset or malformed
+static unsigned int env_uint(const char* name, unsigned int fallback) {
+    const char* value = std::getenv(name);
+    if (value == nullptr || *value == '\0') return fallback;
+
+    char* end;
+    unsigned long parsed = std::strtoul(value, &end, 10);
+    return *end == '\0' ? static_cast<unsigned int>(parsed) : fallback;
+} // env_uint()
+
+// frames a fault on pte takes: two for a shared swap page read back for a write (the shared frame
+// and the copy), none for a sole owner's write fault, which upgrades the pte in place, one otherwise
+static unsigned int fault_frames(const page_table_entry_t &pte, const file_info_t &disk_info, bool write_flag) {
+    if (sole_swap_owner(pte, disk_info)) return 0;
+
+    return !disk_info.file_backed && !pte.read_enable && write_flag && swap_sharer_count(disk_info.block) > 1 ? 2 : 1;
+} // fault_frames()
+
 /*
  * vm_init
  *
@@ -37,22 +72,54 @@ void vm_init(unsigned int memory_pages, unsigned int swap_blocks){
     BASE_ADDR = static_cast<unsigned char*>(vm_physmem);
     MAX_PHYS_PAGES = memory_pages;
 
-    swap_file.resize(swap_blocks);
-    num_swap_block_available = swap_blocks;
+    num_swap_block_available = static_cast<int>(swap_blocks);
 
     // initialize physical page data strcutre
     // i = 0 is the zero pinned page which is never evicted
+    frame_table.assign(memory_pages, phys_page_t{});
+    frame_info.assign(memory_pages, phys_page_info_t{});
     for(unsigned int i = 1 ; i < memory_pages; ++i){
-        std::shared_ptr<phys_page_t> page = std::make_shared<phys_page_t>(); 
-        page->ppn = i;
-        page_map[i] = page;
-        open_phys_pages.insert(i);
+        frame_table[i].ppn = i;
     }
 
-    for(unsigned int i = 0; i < swap_blocks; ++i){
-        open_swap_pages.insert(i);
+    // superpages are off unless VM_SUPERPAGE asks for them, in pages per superpage: a power of two,
+    // at most the arena and a quarter of the frames so several runs of frames can be whole at once
+    unsigned int superpage_max = std::bit_floor(std::max(1u, std::min(NUM_VPAGES, memory_pages / 4)));
+    superpage_pages = std::min(std::bit_floor(std::max(1u, env_uint("VM_SUPERPAGE", 1))), superpage_max);
+
+    // the free pool counts its frames per run of superpage_pages for the superpage allocator
+    free_pool_init(memory_pages);
+
+    swap_map_init(swap_blocks);
+
+    // vm_init's signature is fixed by the infrastructure, so the replacement policy comes from the environment
+    const char* policy = std::getenv("VM_POLICY");
+    replacement_policy = make_replacement_policy(policy ? policy : "clock");
+    if (!replacement_policy) {
+        replacement_policy = make_replacement_policy("clock");
     }
 
+    // reclaim watermarks, same story: VM_RECLAIM_LOW / _HIGH / _BATCH
+    // at most half the frames are kept free, the faulting process needs the rest resident to make progress
+    unsigned int usable = memory_pages > 1 ? memory_pages - 1 : 1;
+    unsigned int max_free = std::max(1u, usable / 2);
+    reclaim_low = std::min(std::max(1u, env_uint("VM_RECLAIM_LOW", usable / 16)), max_free);
+    reclaim_high = std::min(std::max(reclaim_low, env_uint("VM_RECLAIM_HIGH", std::max(reclaim_low + 1, usable / 8))), max_free);
+    reclaim_batch = std::max(1u, env_uint("VM_RECLAIM_BATCH", reclaim_high));
+
+    // same-page merging is off unless VM_MERGE_INTERVAL asks for it
+    merge_interval = env_uint("VM_MERGE_INTERVAL", 0);
+
+    // how far swap may be promised past the swap file: VM_OVERCOMMIT=strict (default), heuristic or always
+    const char* overcommit = std::getenv("VM_OVERCOMMIT");
+    std::string mode = overcommit ? overcommit : "strict";
+    overcommit_mode = mode == "always" ? OVERCOMMIT_ALWAYS
+                    : mode == "heuristic" ? OVERCOMMIT_HEURISTIC
+                    : OVERCOMMIT_STRICT;
+
+    // the compressed swap cache is off unless VM_ZSWAP_PAGES asks for it, in pages' worth of compressed bytes
+    zswap_limit = static_cast<size_t>(env_uint("VM_ZSWAP_PAGES", 0)) * VM_PAGESIZE;
+
     // Create zero pinned page
     std::memset(BASE_ADDR, 0, VM_PAGESIZE);
     // check_states();
@@ -78,42 +145,53 @@ int vm_create(pid_t parent_pid, pid_t child_pid){
     else {
         pcb_t &parent = process_map[parent_pid];
 
-        if(parent.num_swap_reserved > num_swap_block_available){
+        // the child is charged for every swap-backed page it shares, a block is only bound once a copy is written out
+        if (!swap_commit_allowed(parent.num_swap_reserved, 0)) {
             return -1;
         }
 
-        process_map[child_pid] = parent;
+        // the MMU reads and updates each process's page table in place, so the child gets its own
+        // copy of the mapped ptes; the disk metadata is shared chunk by chunk until either side changes it.
+        // The child starts on no reverse maps (links are added below) and with no readahead streams
+        pcb_t &child = process_map[child_pid];
+        std::copy_n(parent.page_table, parent.next_vm_page, child.page_table);
+        std::copy_n(parent.advice, parent.next_vm_page, child.advice);
+        child.pages_on_disk = parent.pages_on_disk;
+        child.next_vm_page = parent.next_vm_page;
+        child.free_vpns = parent.free_vpns;
+        child.num_swap_reserved = parent.num_swap_reserved;
 
         num_swap_block_available -= parent.num_swap_reserved;
 
         // make sure pages are marked as shared (swap_backed)
-        for(size_t i = 0; i < process_map[child_pid].next_vm_page; ++i){
-            auto &file_info = process_map[child_pid].pages_on_disk[i];
+        for(size_t i = 0; i < child.next_vm_page; ++i){
+            auto &file_info = child.pages_on_disk[i];
 
-            auto &parent_pte = process_map[parent_pid].page_table[i];
-            auto &child_pte = process_map[child_pid].page_table[i];
+            // a hole left by vm_unmap
+            if (!file_info.valid) continue;
+
+            auto &parent_pte = parent.page_table[i];
+            auto &child_pte = child.page_table[i];
 
             if(!file_info.file_backed){
 
-                // Add count to pages pointing at block in swap file
-                swap_file[file_info.block].insert(child_pid);
+                // Add count to pages pointing at the slot
+                swap_sharer_add(file_info.block, child_pid);
 
                 parent_pte.write_enable = 0;
                 child_pte.write_enable = 0;
 
                 // If parent page is currently RESIDENT, add child PTE to physical page
                 if (parent_pte.read_enable && parent_pte.ppage != 0) {
-                    page_map[parent_pte.ppage]->ptes.emplace(child_pid, i);
+                    frame_rmap_add(parent_pte.ppage, child_pid, i);
                 }
 
             }
             else {
-                auto &pte_q = file_backed_pages[file_info.filename].block_to_file[file_info.block].ptes;
-
-                pte_q.emplace(child_pid, i);
+                file_rmap_add(fcb_pool[file_info.fcb], child_pid, i);
 
                 if (parent_pte.read_enable && parent_pte.ppage != 0) {
-                    page_map[parent_pte.ppage]->ptes.emplace(child_pid, i);
+                    frame_rmap_add(parent_pte.ppage, child_pid, i);
                 }
             }
         }
@@ -137,6 +215,12 @@ void vm_switch(pid_t pid){
     current_pid = pid;
     page_table_base_register = process_map[pid].page_table;
 
+    // nobody is waiting on a fault here, so this is where dirty frames get written behind
+    clean_dirty_frames();
+
+    // and where identical frames of different processes get merged, if enabled
+    maybe_merge_pages();
+
     // check_states();
 } // vm_switch()
 
@@ -162,15 +246,46 @@ int vm_fault(const void* addr, bool write_flag){
     // get vpn
     auto vpn = static_cast<unsigned int>((va - ARENA_BASE) / VM_PAGESIZE);
 
-    // Get pte & disk_info
+    // Get pte & disk_info -- read-only, the handlers that change it go through pages_on_disk.mut()
     page_table_entry_t &pte = pcb.page_table[vpn];
-    file_info_t &disk_info = pcb.pages_on_disk[vpn];
+    const file_info_t &disk_info = pcb.pages_on_disk[vpn];
 
     // Invalid Virtual Address
     if (!disk_info.valid) {
         return -1;
     }
 
+    // An advised sequential stream is past the pages behind it: reclaim below takes their frames first
+    if (pcb.advice[vpn] == VM_ADVICE_SEQUENTIAL) {
+        drop_behind(vpn);
+    }
+
+    // Batch reclaim below the low watermark, before the handlers touch any page-table, reverse-map or
+    // frame state: an eviction in the middle of a handler could take a frame it is working on.
+    // Best effort, a victim that cannot be written out only leaves the pool lower
+    if (open_phys_pages.size() < reclaim_low) {
+        reclaim_frames(std::min<size_t>(reclaim_high, open_phys_pages.size() + reclaim_batch));
+    }
+
+    // Free the frames this fault needs before touching any state: under overcommit a victim
+    // may have nowhere to be written, and if no other frame can go either the fault fails here.
+    // A sole owner's write fault takes none, so it must not evict anything either
+    unsigned int frames_needed = fault_frames(pte, disk_info, write_flag);
+    if (!reclaim_frames(frames_needed)) {
+        return -1;
+    }
+
+    // That reclaim may have evicted the faulting page itself: a shared page written to then
+    // has to be read back into a frame of its own before it is copied
+    if (fault_frames(pte, disk_info, write_flag) > frames_needed && !reclaim_frames(2)) {
+        return -1;
+    }
+
+    // a fault in a run of pages that can become a superpage fills the whole run
+    if (superpage_pages > 1 && superpage_fault(vpn)) {
+        return 0;
+    }
+
     if (disk_info.file_backed) {
         // Find next available page in physical memory & handle eviction
         unsigned int next_page = get_next_ppn();
@@ -203,89 +318,19 @@ int vm_fault(const void* addr, bool write_flag){
  * clean up any resources used by the process.
  */
 void vm_destroy(){
-    // Update dirty and reference bits of phys memory pages before any pte is destroyed
-    update_reference_bits();
-
-    num_swap_block_available += process_map[current_pid].num_swap_reserved;
-
-    for(size_t i = 0; i < process_map[current_pid].next_vm_page; ++i){
-
-        page_table_entry_t& pte = process_map[current_pid].page_table[i];
-
-        file_info_t& file_info = process_map[current_pid].pages_on_disk[i];
-
-        if(!file_info.file_backed){
-            swap_file[file_info.block].erase(current_pid);
+    auto &pcb = process_map[current_pid];
 
-            if (swap_file[file_info.block].size() == 0) {
-                open_swap_pages.insert(file_info.block);
-            }
-            else if (swap_file[file_info.block].size() == 1) {
-                // std::cout << "File_info.block: " << file_info.block << std::endl;
-                auto last_pid = *swap_file[file_info.block].begin();
+    num_swap_block_available += pcb.num_swap_reserved;
 
-                auto &pte_swap = process_map[last_pid].page_table[i];
+    // Only this process's pages are touched, so teardown scales with the process, not the machine
+    for(size_t i = 0; i < pcb.next_vm_page; ++i){
 
-                if (pte_swap.read_enable && pte_swap.ppage != 0) {
-                    // std::cout << "READ WRITE SET TO 1" << std::endl;
-                    set_pte_bits(pte_swap, -1, 1, 1, -1, -1);
-                }
-            }
-        }
-        else {
-            // should remove it from the file_backed_pages data stryctyre;
-            auto &ptes_q = file_backed_pages[file_info.filename].block_to_file[file_info.block].ptes;
-            size_t e = ptes_q.size();
-            for(size_t j = 0; j < e; ++j){
-                auto &pair = ptes_q.front();
-                ptes_q.pop();
-                if (pair.first != current_pid){
-                    ptes_q.push(pair);
-                }
-            }
-        }
+        // unmapped by vm_unmap, nothing to release
+        if (!pcb.pages_on_disk[i].valid) continue;
 
-        set_pte_bits(pte, 0, 0, 0, 0, 0);
+        release_page(static_cast<unsigned int>(i));
     }
 
-    // correct the state of our global phys_page map
-    for (size_t p = 1; p < MAX_PHYS_PAGES; p++) {
-        auto &phys_page = page_map[p];
-
-        size_t n = phys_page->ptes.size();
-        // remove entrys that are from this process
-        for (size_t i = 0; i < n; i++) {
-            auto& pair = phys_page->ptes.front();
-            phys_page->ptes.pop();
-
-            if (pair.first != current_pid) {
-                phys_page->ptes.push(pair);
-            }
-        }
-
-        // clear and set free the phys_page if it only was for this process
-        if (phys_page->ptes.empty() && !phys_page->file_backed) {
-            open_phys_pages.insert(p);
-
-            // remove from clock algorithm:
-            size_t n = clock_queue.size();
-            for(size_t i = 0; i < n; ++i){
-                auto page = clock_queue.front();
-                clock_queue.pop();
-
-                if (page->ppn != p) {
-                    clock_queue.push(page);
-                }
-            }
-
-            phys_page->ref = 0;
-            phys_page->dirty = 0;
-            phys_page->file_backed = 0;
-            phys_page->block = -1;
-            phys_page->filename = "";
-        }
-
-    }
     process_map.erase(current_pid);
 
     // std::cout << "END" << std::endl;
@@ -319,11 +364,30 @@ void* vm_map(const char* filename, unsigned int block){
     // check_states();
     // std::cout << "vm_map called\n";
     // check_states();
+    return vm_map_range(filename, block, 1);
+}
+
+/*
+ * vm_map_range
+ *
+ * vm_map for count consecutive pages in one call: pages [0, count) of the
+ * returned range are backed by the swap file, or by blocks first_block ..
+ * first_block + count - 1 of filename. The range is mapped in full or not at
+ * all; vm_map_range returns nullptr if count is 0, if the arena has no run of
+ * count unmapped pages or the swap file (under overcommit_mode) cannot hold
+ * it, or if filename is not valid.
+ */
+void* vm_map_range(const char* filename, unsigned int first_block, unsigned int count){
     auto &pcb = process_map[current_pid];
 
-    unsigned int vpn = pcb.next_vm_page;
+    if (count == 0) {
+        return nullptr;
+    }
+
+    // lowest run of count unmapped pages, holes left by vm_unmap first
+    unsigned int vpn = vpn_range_find(pcb, count);
 
-    if (static_cast<uintptr_t>(vpn * VM_PAGESIZE) >= VM_ARENA_SIZE){
+    if (vpn == NUM_VPAGES){
         return nullptr; // arena is full
     }
 
@@ -331,66 +395,179 @@ void* vm_map(const char* filename, unsigned int block){
 
     // swap back page reservation
     if (filename == nullptr) {
-        if(num_swap_block_available < 1){
+        // the whole range is charged at once, overcommit_mode decides how far past the swap file we go
+        if (!swap_commit_allowed(static_cast<int>(count), pcb.num_swap_reserved)) {
             return nullptr;
         }
 
-        set_pte_bits(pcb.page_table[vpn], 0, 1, 0, 0, 0);
+        for (unsigned int i = 0; i < count; ++i) {
+            set_pte_bits(pcb.page_table[vpn + i], 0, 1, 0, 0, 0);
 
-        ++pcb.next_vm_page;
+            // a slot reading as zeros, its block is bound when the page is first written out
+            // (next to its neighbours', so the range ends up contiguous in the swap file)
+            int p = swap_slot_alloc();
 
-        // reserve block
-        unsigned int p = *open_swap_pages.begin();
+            auto &disk_info = pcb.pages_on_disk.mut(vpn + i);
+            disk_info.file_backed = false;
+            disk_info.fcb = FCB_NIL;
+            disk_info.block = p;
+            disk_info.valid = true;
 
-        open_swap_pages.erase(p);
-
-        pcb.pages_on_disk[vpn].block = p;
-
-        swap_file[p].insert(current_pid);
+            swap_sharer_add(p, current_pid);
+        }
 
-        // eager block reservation count
-        pcb.num_swap_reserved++;
-        num_swap_block_available--;
+        pcb.num_swap_reserved += static_cast<int>(count);
+        num_swap_block_available -= static_cast<int>(count);
 
         // insert into vp_page_map
     } else {
+        // the last block must not wrap around
+        if (count - 1 > ~0u - first_block) {
+            return nullptr;
+        }
+
         std::string fname;
 
         if (!read_string_from_va(filename, fname)) {
             return nullptr;
         }
 
-        auto &block_mapping = file_backed_pages[fname].block_to_file[block];
+        // the path is read and hashed once here, everything after works on its id and the (file, block) handles
+        unsigned int file = intern_file(fname);
+
+        for (unsigned int i = 0; i < count; ++i) {
+            unsigned int fcb = fcb_get(file, first_block + i);
+
+            auto &block_mapping = fcb_pool[fcb];
 
-        // Shared file-backed page -> step 1
-        if (block_mapping.ppn) {
-            auto &ppn = block_mapping.ppn;
+            // Shared file-backed page -> step 1
+            if (block_mapping.ppn) {
+                auto &ppn = block_mapping.ppn;
 
-            page_map[ppn]->ptes.emplace(current_pid, vpn);
-            block_mapping.ptes.emplace(current_pid, vpn);
+                frame_rmap_add(ppn, current_pid, vpn + i);
+                file_rmap_add(block_mapping, current_pid, vpn + i);
 
-            set_pte_bits(
-                pcb.page_table[vpn], 
-                ppn, 
-                1, 1, 
-                0, 
-                0);
+                set_pte_bits(
+                    pcb.page_table[vpn + i], 
+                    ppn, 
+                    1, 1, 
+                    0, 
+                    0);
+            }
+            else {
+                set_pte_bits(pcb.page_table[vpn + i], 0, 0, 0, 0, 0);
+
+                file_rmap_add(block_mapping, current_pid, vpn + i);
+            }
+
+            auto &disk_info = pcb.pages_on_disk.mut(vpn + i);
+            disk_info.file_backed = true;
+            disk_info.fcb = fcb;
+            disk_info.block = static_cast<int>(first_block + i);
+            disk_info.valid = true;
         }
-        else {
-            set_pte_bits(pcb.page_table[vpn], 0, 0, 0, 0, 0);
+    }
+
+    vpn_range_take(pcb, vpn, count);
+
+    // check_states();
+    return reinterpret_cast<void*>(address);
+} // vm_map_range()
+
+/*
+ * vm_advise
+ *
+ * Access pattern advice for the current process's pages overlapping
+ * [addr, addr + len): sequential and random are kept per vpn and read by
+ * readahead and reclaim, willneed prefetches the range into free frames and
+ * free lets reclaim drop its swap-backed pages without writing them.
+ * Returns -1, with nothing changed, if advice is unknown or the range holds
+ * a page that is not valid.
+ */
+int vm_advise(const void* addr, size_t len, vm_advice_t advice){
+    auto &pcb = process_map[current_pid];
+    auto va = reinterpret_cast<uintptr_t>(addr);
+
+    if (va < ARENA_BASE || va >= ARENA_BASE + VM_ARENA_SIZE || len > ARENA_BASE + VM_ARENA_SIZE - va) {
+        return -1;
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    auto first = static_cast<unsigned int>((va - ARENA_BASE) / VM_PAGESIZE);
+    auto last = static_cast<unsigned int>((va - ARENA_BASE + len - 1) / VM_PAGESIZE);
 
-            block_mapping.ptes.emplace(current_pid, vpn);
+    for (unsigned int vpn = first; vpn <= last; ++vpn) {
+        if (!pcb.pages_on_disk[vpn].valid) {
+            return -1;
+        }
+    }
+
+    switch (advice) {
+    case VM_ADVICE_NORMAL:
+    case VM_ADVICE_SEQUENTIAL:
+    case VM_ADVICE_RANDOM:
+        std::fill(pcb.advice + first, pcb.advice + last + 1, advice);
+        return 0;
+
+    case VM_ADVICE_WILLNEED:
+        willneed_prefetch(first, last - first + 1);
+        // check_states();
+        return 0;
+
+    case VM_ADVICE_FREE:
+        discard_pages(first, last - first + 1);
+        // check_states();
+        return 0;
+    }
+
+    return -1;
+} // vm_advise()
+
+/*
+ * vm_unmap
+ *
+ * Unmaps the npages pages of the current process starting at the page
+ * aligned addr: their frames, swap slots and reverse-map entries are released
+ * and their swap charge is given back, and the vpns can be mapped again.
+ * Returns -1, with nothing changed, if the range is not page aligned, leaves
+ * the arena, is empty or holds a page that is not valid.
+ */
+int vm_unmap(const void* addr, unsigned int npages){
+    auto &pcb = process_map[current_pid];
+    auto va = reinterpret_cast<uintptr_t>(addr);
+
+    if (va < ARENA_BASE || va >= ARENA_BASE + VM_ARENA_SIZE || (va - ARENA_BASE) % VM_PAGESIZE != 0) {
+        return -1;
+    }
+
+    auto vpn = static_cast<unsigned int>((va - ARENA_BASE) / VM_PAGESIZE);
+
+    if (npages == 0 || npages > NUM_VPAGES - vpn) {
+        return -1;
+    }
+
+    for (unsigned int i = vpn; i < vpn + npages; ++i) {
+        if (!pcb.pages_on_disk[i].valid) {
+            return -1;
+        }
+    }
+
+    for (unsigned int i = vpn; i < vpn + npages; ++i) {
+        if (!pcb.pages_on_disk[i].file_backed) {
+            --pcb.num_swap_reserved;
+            ++num_swap_block_available;
         }
 
-        pcb.pages_on_disk[vpn].file_backed = true;
-        pcb.pages_on_disk[vpn].filename = fname;
-        pcb.pages_on_disk[vpn].block = block;
+        release_page(i);
 
-        ++pcb.next_vm_page;
+        pcb.pages_on_disk.mut(i) = file_info_t{};
+        pcb.advice[i] = VM_ADVICE_NORMAL;
     }
-    
-    pcb.pages_on_disk[vpn].valid = true;
+
+    vpn_range_free(pcb, vpn, npages);
 
     // check_states();
-    return reinterpret_cast<void*>(address);
-}
\ No newline at end of file
+    return 0;
+} // vm_unmap()
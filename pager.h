@@ -1,10 +1,12 @@
 #pragma once 
 
+#include <list>
+#include <map>
+#include <memory>
 #include <string>
-#include <queue> 
 #include <unordered_map>
 #include <unordered_set>
-#include <memory>
+#include <vector>
 
 #include "vm_pager.h"
 #include "vm_arena.h"
@@ -40,22 +42,101 @@ extern unsigned int MAX_PHYS_PAGES;
 
 extern pid_t current_pid;
 
+// swap-backed pages charged so far, subtracted from the swap file's size
+// (negative once overcommit_mode lets charges run past the swap file)
 extern int num_swap_block_available;
 
+// last frame visited by the write-behind cleaner
+extern unsigned int cleaner_hand;
+
+// number of frames tracked by the replacement policy
+extern unsigned int tracked_frames;
+
+// reclaim starts (at the top of vm_fault) once fewer than reclaim_low frames are free
+// and frees up to reclaim_high of them, evicting at most reclaim_batch pages per run
+extern unsigned int reclaim_low;
+extern unsigned int reclaim_high;
+extern unsigned int reclaim_batch;
+
+/*
+ * File ids:
+ * 
+ * Every path given to vm_map is interned once into a small id, an index into
+ * file_names. Page metadata only carries the id (through its fcb), the
+ * path is looked up again only to call file_read / file_write.
+ * FILE_NONE marks a free fcb, FCB_NIL a missing fcb handle (pager_fcb.h).
+ */
+static constexpr unsigned int FILE_NONE = 0xFFFFFFFF;
+static constexpr unsigned int FCB_NIL = 0xFFFFFFFF;
+
+/*
+ * rmap_node_t:
+ * 
+ * One (pid, vpn) entry of a reverse map. Nodes live in rmap_pool and are
+ * linked by index, so insert and unlink are O(1) and walks never mutate
+ * the list. RMAP_NIL terminates a list.
+ */
+static constexpr unsigned int RMAP_NIL = 0xFFFFFFFF;
+
+struct rmap_node_t {
+    pid_t pid = 0;                              // process mapping the page
+    unsigned int vpn = 0;                       // virtual page in that process
+    unsigned int prev = RMAP_NIL;               // previous node on the list
+    unsigned int next = RMAP_NIL;               // next node on the list
+};
+
+/*
+ * rmap_list_t:
+ * 
+ * Head of a reverse map: every (pid, vpn) pointing at a frame or file block
+ */
+struct rmap_list_t {
+    unsigned int head = RMAP_NIL;
+    unsigned int size = 0;
+};
+
+/*
+ * pte_rmap_t:
+ * 
+ * Per-vpn handles into the reverse maps, so a single (pid, vpn) can be
+ * unlinked without searching. RMAP_NIL if the vpn is not on that list.
+ */
+struct pte_rmap_t {
+    unsigned int frame_node = RMAP_NIL;         // node on the resident frame's ptes
+    unsigned int file_node = RMAP_NIL;          // node on the fcb's ptes
+};
+
 /*
  * phys_page_t:
  * 
- * Data structure for the clock replacement algorithm
- * Assists in making page evictions
+ * Hot per-frame state for the page replacement policy
+ * Stored densely in frame_table (indexed by ppn) so eviction scans stay in cache
  */
 struct phys_page_t {
     unsigned int ppn = 0;                       // physical page offset
     int ref = 0;                                // referenced bit
     int dirty = 0;                              // dirty bit
     int file_backed = 0;                        // file_backed bit
-    int block = -1;                             // block -- if -1 its invalid
-    std::string filename = "";                       // filename
-    std::queue<std::pair<pid_t, unsigned int>> ptes;     // list of pid, vpn for each place this phys_page was pointed to
+    int block = -1;                             // file block, or swap slot if swap-backed -- if -1 its invalid
+    int tracked = 0;                            // frame holds a page and is tracked by the replacement policy
+    int list = 0;                               // which of the policy's lists the frame is on
+    unsigned int list_prev = 0;                 // previous frame on that list
+    unsigned int list_next = 0;                 // next frame on that list
+    int drop_behind = 0;                        // on drop_behind_frames, evicted ahead of the policy's victims
+    int lazy_free = 0;                          // contents freed by VM_ADVICE_FREE, dropped at eviction unless written since
+    int super = 0;                              // part of an intact superpage (pager_super.h)
+};
+
+/*
+ * phys_page_info_t:
+ * 
+ * Cold per-frame state, only touched on file I/O and reverse-map walks
+ * Stored in frame_info, parallel to frame_table
+ */
+struct phys_page_info_t {
+    unsigned int fcb = FCB_NIL;                 // fcb of the file block held, FCB_NIL if swap-backed or free
+    rmap_list_t ptes;                           // list of pid, vpn for each place this phys_page was pointed to
+    std::list<unsigned int>::iterator drop_node; // place on drop_behind_frames while drop_behind is set
 };
 
 /*
@@ -66,9 +147,51 @@ struct phys_page_t {
  */
 struct file_info_t {
     bool file_backed = false;   // is this pte file backed
-    int block = 0;             // the block of the file or the swap file that this maps to -- -1 if not set (assert)
+    int block = 0;             // the block of the file, or the swap slot (pager_swap.h), that this maps to -- -1 if not set (assert)
     bool valid = false;
-    std::string filename;       // name of the file
+    unsigned int fcb = FCB_NIL;     // fcb of the file block (pager_fcb.h)
+};
+
+/*
+ * disk_table_t:
+ * 
+ * A process's file_info_t per vpn, in chunks of DISK_CHUNK entries held by
+ * reference. vm_create hands the child the parent's chunks as they are, and
+ * whichever side first changes an entry copies that chunk for itself (mut),
+ * so a fork copies NUM_VPAGES / DISK_CHUNK pointers instead of NUM_VPAGES entries and strings.
+ * A chunk that was never written reads as invalid entries.
+ */
+static constexpr unsigned int DISK_CHUNK = 16;
+static_assert(NUM_VPAGES % DISK_CHUNK == 0);
+
+struct disk_chunk_t {
+    file_info_t entries[DISK_CHUNK];
+};
+
+struct disk_table_t {
+    std::shared_ptr<disk_chunk_t> chunks[NUM_VPAGES / DISK_CHUNK];
+
+    const file_info_t& operator[](unsigned int vpn) const {
+        static const file_info_t unmapped;
+
+        auto &chunk = chunks[vpn / DISK_CHUNK];
+        return chunk ? chunk->entries[vpn % DISK_CHUNK] : unmapped;
+    }
+
+    // entry of vpn to be modified, its chunk is made private to this process first
+    file_info_t& mut(unsigned int vpn);
+};
+
+/*
+ * readahead_t:
+ * 
+ * Sequential stream detection for one file in one process
+ * A fault at next_block continues the stream and doubles the window,
+ * any other block restarts it with no readahead
+ */
+struct readahead_t {
+    unsigned int next_block = 0;                // block the next fault hits if the stream is sequential
+    unsigned int window = 0;                    // blocks read ahead on the last sequential fault
 };
 
 /*
@@ -78,40 +201,45 @@ struct file_info_t {
  */
 struct pcb_t {
     page_table_entry_t  page_table[NUM_VPAGES];
-    file_info_t  pages_on_disk [NUM_VPAGES];          // this is necessary in the situation that the page is evicted and replaced and is in the memory
-    unsigned int next_vm_page = 0;
+    disk_table_t pages_on_disk;                       // this is necessary in the situation that the page is evicted and replaced and is in the memory
+    pte_rmap_t   rmap [NUM_VPAGES];                   // handles of each vpn on the frame / fcb reverse maps -- frame_node doubles as the resident set
+    unsigned int next_vm_page = 0;                    // one past the highest mapped vpn, nothing from here up is mapped
+    std::map<unsigned int, unsigned int> free_vpns;   // unmapped runs below next_vm_page, first vpn -> length
     int num_swap_reserved;
+    std::unordered_map<unsigned int, readahead_t> readahead;  // file-backed streams, by file id
+    vm_advice_t advice[NUM_VPAGES] = {};              // access pattern given by vm_advise, per vpn
 };
 
 /* 
  * File Control Block (fcb_t):
  * 
- * Will be stored in a map to all us to map filenames
+ * Will be stored in fcb_pool to all us to map a file and block
  * to respective physical addresses if its a resident
  * Multiple page table entries to the same file
+ * Found by (file, block) through the index in pager_fcb.h
  * 
  */
 struct fcb_t {
+    unsigned int file = FILE_NONE;              // file id -- FILE_NONE while the handle is free
+    unsigned int block = 0;                     // block of the file
     unsigned int ppn = 0;
-    std::queue<std::pair<pid_t, unsigned int>> ptes;
-};
-
-struct block_map {
-    std::unordered_map<unsigned int, fcb_t> block_to_file;
+    rmap_list_t ptes;
 };
 
 /* 
- * {<key> = PPN | <value> = physical_page_t} 
+ * Frame table: index = PPN, sized to MAX_PHYS_PAGES at vm_init
  * This will map physical page numbers to any useful information.
  * This will allow us to evict stuff effectively
- * Map to update clock algo
+ * frame_table holds the hot fields, frame_info the cold ones
  */
-extern std::unordered_map<unsigned int, std::shared_ptr<phys_page_t>> page_map;
+extern std::vector<phys_page_t> frame_table;
+extern std::vector<phys_page_info_t> frame_info;
 
 /*
- * Queue for the clock eviction algorithm
+ * Node storage for every reverse map, plus the head of its free list
  */
-extern std::queue<std::shared_ptr<phys_page_t>> clock_queue;
+extern std::vector<rmap_node_t> rmap_pool;
+extern unsigned int rmap_free;
 
 /*
  * This will map each pid_t to the respective pcb.  
@@ -119,21 +247,24 @@ extern std::queue<std::shared_ptr<phys_page_t>> clock_queue;
 extern std::unordered_map<pid_t, pcb_t> process_map;
 
 /*
- * Map each filename to their respective fcb
+ * Interned paths: file_names[id] is the path of file id, file_ids maps it back
  */
-extern std::unordered_map<std::string, block_map> file_backed_pages;
+extern std::vector<std::string> file_names;
+extern std::unordered_map<std::string, unsigned int> file_ids;
 
 /*
- * Keep track of open physical pages
+ * Every fcb, by handle
  */
-extern std::unordered_set<unsigned int> open_phys_pages;
+extern std::vector<fcb_t> fcb_pool;
 
 /*
- * Keep track of open swap pages
+ * Frames reclaim takes before asking the replacement policy, oldest first:
+ * those of advised sequential pages that their stream has moved past
+ * (drop-behind) and those whose contents were freed (lazy_free)
  */
-extern std::unordered_set<unsigned int> open_swap_pages;
+extern std::list<unsigned int> drop_behind_frames;
 
 /*
- * Keep track of how many swap_back pages pointing at a block in swap file
+ * Keep track of open physical pages -- changed through free_pool_add / free_pool_remove (pager_super.h)
  */
-extern std::vector<std::unordered_set<pid_t>> swap_file;
\ No newline at end of file
+extern std::unordered_set<unsigned int> open_phys_pages;
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include <cassert>
+#include <vector>
+
+#include "pager_fcb.h"
+
+namespace {
+
+/*
+ * fcb_index_slot_t:
+ *
+ * One table slot: the packed (file, block) key and its handle, FCB_NIL if empty
+ */
+struct fcb_index_slot_t {
+    uint64_t key = 0;
+    unsigned int fcb = FCB_NIL;
+};
+
+std::vector<fcb_index_slot_t> fcb_index;        // capacity is 0 or a power of two
+size_t fcb_index_used = 0;
+std::vector<unsigned int> fcb_free;             // erased handles
+
+uint64_t fcb_key(unsigned int file, unsigned int block) {
+    return (static_cast<uint64_t>(file) << 32) | block;
+}
+
+size_t fcb_home(uint64_t key) {
+    // murmur3 finalizer, consecutive blocks of a file spread over the table
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    return static_cast<size_t>(key) & (fcb_index.size() - 1);
+}
+
+// position of key in the table, or of the empty slot that ends its probe
+size_t fcb_probe(uint64_t key) {
+    size_t i = fcb_home(key);
+    while (fcb_index[i].fcb != FCB_NIL && fcb_index[i].key != key) {
+        i = (i + 1) & (fcb_index.size() - 1);
+    }
+    return i;
+}
+
+void fcb_index_grow() {
+    std::vector<fcb_index_slot_t> old(fcb_index.empty() ? 64 : fcb_index.size() * 2);
+    old.swap(fcb_index);
+
+    for (auto &slot : old) {
+        if (slot.fcb != FCB_NIL) fcb_index[fcb_probe(slot.key)] = slot;
+    }
+}
+
+} // namespace
+
+unsigned int fcb_find(unsigned int file, unsigned int block) {
+    if (fcb_index.empty()) return FCB_NIL;
+
+    return fcb_index[fcb_probe(fcb_key(file, block))].fcb;
+} // fcb_find()
+
+unsigned int fcb_get(unsigned int file, unsigned int block) {
+    // at most 3/4 full, so probes stay short
+    if ((fcb_index_used + 1) * 4 > fcb_index.size() * 3) {
+        fcb_index_grow();
+    }
+
+    uint64_t key = fcb_key(file, block);
+    auto &slot = fcb_index[fcb_probe(key)];
+    if (slot.fcb != FCB_NIL) return slot.fcb;
+
+    unsigned int fcb;
+    if (!fcb_free.empty()) {
+        fcb = fcb_free.back();
+        fcb_free.pop_back();
+    }
+    else {
+        fcb = static_cast<unsigned int>(fcb_pool.size());
+        fcb_pool.emplace_back();
+    }
+
+    fcb_pool[fcb] = fcb_t{};
+    fcb_pool[fcb].file = file;
+    fcb_pool[fcb].block = block;
+
+    slot.key = key;
+    slot.fcb = fcb;
+    ++fcb_index_used;
+
+    return fcb;
+} // fcb_get()
+
+void fcb_erase(unsigned int fcb) {
+    auto &entry = fcb_pool[fcb];
+    assert(entry.ppn == 0 && entry.ptes.size == 0);
+
+    size_t hole = fcb_probe(fcb_key(entry.file, entry.block));
+    size_t mask = fcb_index.size() - 1;
+
+    // backward shift: pull later entries of the cluster into the hole unless that would move them before their home
+    for (size_t i = (hole + 1) & mask; fcb_index[i].fcb != FCB_NIL; i = (i + 1) & mask) {
+        size_t home = fcb_home(fcb_index[i].key);
+
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            fcb_index[hole] = fcb_index[i];
+            hole = i;
+        }
+    }
+    fcb_index[hole] = fcb_index_slot_t{};
+    --fcb_index_used;
+
+    entry = fcb_t{};
+    fcb_free.push_back(fcb);
+} // fcb_erase()
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+#include "pager.h"
+
+/***************************************************************************************************
+ *                                     (file, block) Index                                         *
+ ***************************************************************************************************/
+
+/*
+ * fcb index:
+ *
+ * One flat open-addressing table (linear probing, power-of-two capacity)
+ * from (file id, block) to a handle into fcb_pool. Handles stay valid until
+ * fcb_erase, so file_info_t and the frames keep them and only vm_map and the
+ * readahead path look anything up. An fcb lives while its block is mapped or
+ * resident: the last of release_page() and evict_frame() to let go erases it.
+ */
+
+/*
+ * Handle of the fcb for (file, block), FCB_NIL if there is none
+ */
+unsigned int fcb_find(unsigned int file, unsigned int block);
+
+/*
+ * Handle of the fcb for (file, block), created empty if there is none
+ * May grow fcb_pool: references into it do not survive the call, handles do
+ */
+unsigned int fcb_get(unsigned int file, unsigned int block);
+
+/*
+ * Drops an fcb that is neither resident nor mapped, its handle is reused
+ */
+void fcb_erase(unsigned int fcb);
@@ -0,0 +1,113 @@
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "pager_merge.h"
+#include "pager_swap.h"
+#include "pager_utils.h"
+
+unsigned int merge_interval = 0;
+static unsigned int switches_since_merge = 0;
+
+uint64_t page_hash(const void* page) {
+    static constexpr uint64_t PRIME = 0x9E3779B97F4A7C15ULL;
+
+    auto p = static_cast<const unsigned char*>(page);
+    uint64_t lane[4] = {1, 2, 3, 4};
+
+    for (size_t i = 0; i < VM_PAGESIZE; i += sizeof(lane)) {
+        uint64_t w[4];
+        std::memcpy(w, p + i, sizeof(w));
+
+        for (int l = 0; l < 4; ++l) {
+            lane[l] = (lane[l] ^ w[l]) * PRIME;
+            lane[l] ^= lane[l] >> 29;
+        }
+    }
+
+    return (lane[0] ^ (lane[1] * 3)) + ((lane[2] * 5) ^ (lane[3] * 7));
+} // page_hash()
+
+void maybe_merge_pages() {
+    if (merge_interval == 0) return;
+
+    if (++switches_since_merge < merge_interval) return;
+    switches_since_merge = 0;
+
+    merge_pass();
+} // maybe_merge_pages()
+
+/*
+ * Moves every sharer of dup's slot onto keep's frame and slot and frees
+ * dup's frame and slot. Both frames hold the same bytes at the same vpn.
+ */
+static void merge_frame(unsigned int keep, unsigned int dup, unsigned int vpn) {
+    int keep_slot = frame_table[keep].block;
+    int dup_slot = frame_table[dup].block;
+
+    // keep's sharers grow below, walk a copy of dup's
+    auto range = swap_sharers(dup_slot);
+    std::vector<pid_t> sharers(range.begin(), range.end());
+
+    for (pid_t pid : sharers) {
+        auto &pcb = process_map[pid];
+        auto &pte = pcb.page_table[vpn];
+
+        frame_rmap_remove(dup, pid, vpn);
+
+        // identical bytes, so nothing this pte wrote is lost -- keep's slot is kept in sync by keep's dirty bit
+        set_pte_bits(pte, keep, 1, 0, 0, -1);
+        frame_rmap_add(keep, pid, vpn);
+
+        pcb.pages_on_disk.mut(vpn).block = keep_slot;
+        swap_sharer_add(keep_slot, pid);
+    }
+
+    swap_slot_free(dup_slot);
+
+    release_frame(dup);
+
+    // everybody on the merged frame is a copy-on-write sharer now
+    auto &ptes = frame_info[keep].ptes;
+    for (unsigned int n = ptes.head; n != RMAP_NIL; n = rmap_pool[n].next) {
+        process_map[rmap_pool[n].pid].page_table[rmap_pool[n].vpn].write_enable = 0;
+    }
+} // merge_frame()
+
+unsigned int merge_pass() {
+    // (vpn, hash) -> first frame seen with that content
+    std::unordered_map<uint64_t, std::vector<unsigned int>> seen;
+    unsigned int merged = 0;
+
+    for (unsigned int ppn = 1; ppn < MAX_PHYS_PAGES; ++ppn) {
+        auto &page = frame_table[ppn];
+        auto &ptes = frame_info[ppn].ptes;
+
+        // a freed frame may still be dropped, it must not become anyone else's copy
+        if (!page.tracked || page.file_backed || page.lazy_free || ptes.head == RMAP_NIL) continue;
+
+        unsigned int vpn = rmap_pool[ptes.head].vpn;
+        const unsigned char* bytes = BASE_ADDR + (static_cast<size_t>(ppn) * VM_PAGESIZE);
+
+        uint64_t key = page_hash(bytes) ^ (static_cast<uint64_t>(vpn) * 0xC2B2AE3D27D4EB4FULL);
+        auto &candidates = seen[key];
+
+        bool done = false;
+        for (unsigned int other : candidates) {
+            auto &other_ptes = frame_info[other].ptes;
+
+            // a hash match is only a hint
+            if (rmap_pool[other_ptes.head].vpn != vpn) continue;
+            if (std::memcmp(bytes, BASE_ADDR + (static_cast<size_t>(other) * VM_PAGESIZE), VM_PAGESIZE) != 0) continue;
+
+            merge_frame(other, ppn, vpn);
+            ++merged;
+            done = true;
+            break;
+        }
+
+        if (!done) candidates.push_back(ppn);
+    }
+
+    return merged;
+} // merge_pass()
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include "pager.h"
+
+/***************************************************************************************************
+ *                                    Same-Page Merging (KSM-style)                                *
+ ***************************************************************************************************/
+
+/*
+ * Optional pass that collapses identical resident swap-backed frames into one
+ * write-protected copy-on-write frame, reusing the fork machinery: the merged
+ * pages join one swap block's sharer set, and the first write to any of them
+ * breaks the share in swap_back_fault_in_memory() like after a vm_create.
+ *
+ * Sharers of a swap block must all map it at the same vpn (swap_back_disk()
+ * maps every sharer at the faulting vpn), so only frames at the same vpn in
+ * different processes are merged -- which is what identical initialized
+ * tables in processes running the same program look like.
+ *
+ * Enabled by VM_MERGE_INTERVAL (read in vm_init): a pass every that many
+ * context switches, 0 (the default) turns merging off.
+ */
+extern unsigned int merge_interval;
+
+/*
+ * 64-bit hash of a whole page, four independent lanes so the loop
+ * vectorizes / pipelines instead of serializing on one multiply chain
+ */
+uint64_t page_hash(const void* page);
+
+/*
+ * Called from vm_switch, runs merge_pass() every merge_interval switches
+ */
+void maybe_merge_pages();
+
+/*
+ * Hashes every resident swap-backed frame, verifies candidates with the
+ * same vpn and hash byte for byte and merges them
+ * Returns the number of frames freed
+ */
+unsigned int merge_pass();
@@ -0,0 +1,554 @@
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "pager_policy.h"
+#include "pager_utils.h"
+
+std::unique_ptr<replacement_policy_t> replacement_policy;
+
+void frame_list_push_back(frame_list_t &list, unsigned int ppn) {
+    auto &page = frame_table[ppn];
+
+    ++list.size;
+
+    if (list.head == 0) {
+        page.list_prev = ppn;
+        page.list_next = ppn;
+        list.head = ppn;
+        return;
+    }
+
+    unsigned int tail = frame_table[list.head].list_prev;
+
+    page.list_prev = tail;
+    page.list_next = list.head;
+    frame_table[tail].list_next = ppn;
+    frame_table[list.head].list_prev = ppn;
+} // frame_list_push_back()
+
+void frame_list_remove(frame_list_t &list, unsigned int ppn) {
+    auto &page = frame_table[ppn];
+
+    --list.size;
+
+    if (page.list_next == ppn) {
+        list.head = 0;
+    }
+    else {
+        frame_table[page.list_prev].list_next = page.list_next;
+        frame_table[page.list_next].list_prev = page.list_prev;
+
+        if (list.head == ppn) {
+            list.head = page.list_next;
+        }
+    }
+
+    page.list_prev = 0;
+    page.list_next = 0;
+} // frame_list_remove()
+
+void frame_list_rotate(frame_list_t &list) {
+    if (list.head != 0) {
+        list.head = frame_table[list.head].list_next;
+    }
+} // frame_list_rotate()
+
+uint64_t page_key(unsigned int ppn) {
+    auto &page = frame_table[ppn];
+    auto block = static_cast<uint64_t>(static_cast<unsigned int>(page.block));
+
+    if (page.file_backed) {
+        // file ids are small, so (file, block) packs without hashing the path
+        uint64_t file = fcb_pool[frame_info[ppn].fcb].file;
+        return (((file << 32) | block) << 1) | 1;
+    }
+    return block << 1;
+} // page_key()
+
+namespace {
+
+/*
+ * ghost_list_t:
+ *
+ * Keys of recently evicted pages, oldest first, with O(1) lookup
+ */
+struct ghost_list_t {
+    std::list<uint64_t> order;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> where;
+
+    bool contains(uint64_t key) const { return where.count(key) != 0; }
+
+    size_t size() const { return order.size(); }
+
+    void push_back(uint64_t key) {
+        erase(key);
+        order.push_back(key);
+        where[key] = std::prev(order.end());
+    }
+
+    void erase(uint64_t key) {
+        auto it = where.find(key);
+        if (it == where.end()) return;
+        order.erase(it->second);
+        where.erase(it);
+    }
+
+    void pop_front() {
+        where.erase(order.front());
+        order.pop_front();
+    }
+};
+
+// Number of frames the policies can hand out (frame 0 is pinned)
+unsigned int usable_frames() {
+    return MAX_PHYS_PAGES > 1 ? MAX_PHYS_PAGES - 1 : 1;
+}
+
+/*
+ * CLOCK:
+ *
+ * Second chance. One ring whose head is the hand; new pages go just behind it.
+ */
+class clock_policy_t : public replacement_policy_t {
+    frame_list_t ring;
+
+public:
+    const char* name() const override { return "clock"; }
+
+    void frame_added(unsigned int ppn) override {
+        frame_list_push_back(ring, ppn);
+    }
+
+    void frame_removed(unsigned int ppn) override {
+        frame_list_remove(ring, ppn);
+    }
+
+    // Terminates within two revolutions: the first one clears every ref bit
+    unsigned int select_victim() override {
+        while (true) {
+            unsigned int ppn = ring.head;
+
+            // Fold the pte's reference and dirty bits into the frame only now that the hand is here
+            harvest_reference_bits(ppn);
+
+            if (frame_table[ppn].ref == 0) {
+                frame_list_remove(ring, ppn);
+                return ppn;
+            }
+
+            // second chance, the pte reference bits were cleared by the harvest
+            frame_table[ppn].ref = 0;
+            frame_list_rotate(ring);
+        }
+    }
+};
+
+/*
+ * CLOCK-Pro:
+ *
+ * Resident pages are hot or cold, each kind on its own clock. A new page
+ * starts cold and in its test period; if it is referenced again while still
+ * in test it turns hot. Cold pages evicted during their test period are
+ * remembered as non-resident ghosts -- a fault on one of them means the cold
+ * share was too small, so it grows and the page comes back hot. A ghost that
+ * ages out shrinks the cold share again. The hot hand demotes unreferenced
+ * hot pages whenever the hot clock exceeds its share.
+ */
+class clock_pro_policy_t : public replacement_policy_t {
+    static constexpr int COLD = 0;
+    static constexpr int HOT = 1;
+
+    frame_list_t cold;
+    frame_list_t hot;
+    std::vector<char> in_test;
+    ghost_list_t ghosts;
+    unsigned int cold_target;
+
+    void run_hot_hand() {
+        unsigned int tracked = hot.size + cold.size;
+        unsigned int hot_target = tracked > cold_target ? tracked - cold_target : 0;
+
+        while (hot.size > 0 && hot.size > hot_target) {
+            unsigned int ppn = hot.head;
+
+            harvest_reference_bits(ppn);
+
+            if (frame_table[ppn].ref) {
+                frame_table[ppn].ref = 0;
+                frame_list_rotate(hot);
+                continue;
+            }
+
+            // demote, the page does not get a new test period
+            frame_list_remove(hot, ppn);
+            frame_list_push_back(cold, ppn);
+            frame_table[ppn].list = COLD;
+            in_test[ppn] = 0;
+        }
+    }
+
+public:
+    clock_pro_policy_t()
+        : in_test(MAX_PHYS_PAGES, 0), cold_target(std::max(1u, usable_frames() / 4)) {}
+
+    const char* name() const override { return "clock-pro"; }
+
+    void frame_added(unsigned int ppn) override {
+        uint64_t key = page_key(ppn);
+
+        if (ghosts.contains(key)) {
+            // re-accessed during its test period: cold pages need more room
+            ghosts.erase(key);
+            cold_target = std::min(cold_target + 1, usable_frames());
+
+            frame_list_push_back(hot, ppn);
+            frame_table[ppn].list = HOT;
+            in_test[ppn] = 0;
+        }
+        else {
+            frame_list_push_back(cold, ppn);
+            frame_table[ppn].list = COLD;
+            in_test[ppn] = 1;
+        }
+
+        run_hot_hand();
+    }
+
+    void frame_removed(unsigned int ppn) override {
+        frame_list_remove(frame_table[ppn].list == HOT ? hot : cold, ppn);
+        in_test[ppn] = 0;
+    }
+
+    unsigned int select_victim() override {
+        while (true) {
+            if (cold.size == 0) {
+                // everything is hot, demote one page: with a cold share of 1 the hot hand
+                // stops at the first unreferenced hot page instead of emptying the hot clock
+                unsigned int saved = cold_target;
+                cold_target = 1;
+                run_hot_hand();
+                cold_target = saved;
+                continue;
+            }
+
+            unsigned int ppn = cold.head;
+
+            harvest_reference_bits(ppn);
+
+            if (frame_table[ppn].ref) {
+                frame_table[ppn].ref = 0;
+
+                if (in_test[ppn]) {
+                    // reused within its test period: promote
+                    frame_list_remove(cold, ppn);
+                    frame_list_push_back(hot, ppn);
+                    frame_table[ppn].list = HOT;
+                    in_test[ppn] = 0;
+                    run_hot_hand();
+                }
+                else {
+                    in_test[ppn] = 1;
+                    frame_list_rotate(cold);
+                }
+                continue;
+            }
+
+            frame_list_remove(cold, ppn);
+
+            if (in_test[ppn]) {
+                ghosts.push_back(page_key(ppn));
+
+                // bound the non-resident test pages by the memory size
+                if (ghosts.size() > usable_frames()) {
+                    ghosts.pop_front();
+                    cold_target = std::max(1u, cold_target - 1);
+                }
+            }
+            in_test[ppn] = 0;
+
+            return ppn;
+        }
+    }
+};
+
+/*
+ * ARC:
+ *
+ * Adaptive Replacement Cache. T1 holds pages seen once recently, T2 pages seen
+ * at least twice, B1 / B2 the keys of pages evicted from each; p is the target
+ * size of T1 and moves toward whichever ghost list takes a fault. The pager only
+ * sees references through reference bits, so hits are detected as the lists are
+ * scanned and T1 / T2 are run as clocks (the CAR formulation of ARC).
+ */
+class arc_policy_t : public replacement_policy_t {
+    static constexpr int T1 = 0;
+    static constexpr int T2 = 1;
+
+    frame_list_t t1;
+    frame_list_t t2;
+    ghost_list_t b1;
+    ghost_list_t b2;
+    unsigned int p = 0;
+    unsigned int c;
+
+public:
+    arc_policy_t() : c(usable_frames()) {}
+
+    const char* name() const override { return "arc"; }
+
+    void frame_added(unsigned int ppn) override {
+        uint64_t key = page_key(ppn);
+
+        if (b1.contains(key)) {
+            unsigned int delta = std::max<size_t>(1, b2.size() / b1.size());
+            p = std::min(p + delta, c);
+
+            b1.erase(key);
+            frame_list_push_back(t2, ppn);
+            frame_table[ppn].list = T2;
+            return;
+        }
+        if (b2.contains(key)) {
+            unsigned int delta = std::max<size_t>(1, b1.size() / b2.size());
+            p = p > delta ? p - delta : 0;
+
+            b2.erase(key);
+            frame_list_push_back(t2, ppn);
+            frame_table[ppn].list = T2;
+            return;
+        }
+
+        // keep the directory within 2c entries
+        if (t1.size + b1.size() >= c && b1.size() > 0) {
+            b1.pop_front();
+        }
+        else if (t1.size + t2.size + b1.size() + b2.size() >= 2 * c && b2.size() > 0) {
+            b2.pop_front();
+        }
+
+        frame_list_push_back(t1, ppn);
+        frame_table[ppn].list = T1;
+    }
+
+    void frame_removed(unsigned int ppn) override {
+        frame_list_remove(frame_table[ppn].list == T2 ? t2 : t1, ppn);
+    }
+
+    unsigned int select_victim() override {
+        while (true) {
+            if (t1.size > 0 && (t1.size >= std::max(1u, p) || t2.size == 0)) {
+                unsigned int ppn = t1.head;
+
+                harvest_reference_bits(ppn);
+
+                if (frame_table[ppn].ref == 0) {
+                    frame_list_remove(t1, ppn);
+                    b1.push_back(page_key(ppn));
+                    return ppn;
+                }
+
+                // second reference: the page is frequent now
+                frame_table[ppn].ref = 0;
+                frame_list_remove(t1, ppn);
+                frame_list_push_back(t2, ppn);
+                frame_table[ppn].list = T2;
+            }
+            else {
+                unsigned int ppn = t2.head;
+
+                harvest_reference_bits(ppn);
+
+                if (frame_table[ppn].ref == 0) {
+                    frame_list_remove(t2, ppn);
+                    b2.push_back(page_key(ppn));
+                    return ppn;
+                }
+
+                frame_table[ppn].ref = 0;
+                frame_list_rotate(t2);
+            }
+        }
+    }
+};
+
+/*
+ * 2Q:
+ *
+ * New pages enter the A1in FIFO; pages evicted from it are remembered in the
+ * A1out ghost FIFO, and a fault on one of them goes straight to Am, the main
+ * queue, which is run as a clock. A scan therefore only cycles through A1in and
+ * cannot flush Am.
+ */
+class two_queue_policy_t : public replacement_policy_t {
+    static constexpr int A1IN = 0;
+    static constexpr int AM = 1;
+
+    frame_list_t a1in;
+    frame_list_t am;
+    ghost_list_t a1out;
+    unsigned int kin;
+    unsigned int kout;
+
+public:
+    two_queue_policy_t()
+        : kin(std::max(1u, usable_frames() / 4)), kout(std::max(1u, usable_frames() / 2)) {}
+
+    const char* name() const override { return "2q"; }
+
+    void frame_added(unsigned int ppn) override {
+        uint64_t key = page_key(ppn);
+
+        if (a1out.contains(key)) {
+            a1out.erase(key);
+            frame_list_push_back(am, ppn);
+            frame_table[ppn].list = AM;
+        }
+        else {
+            frame_list_push_back(a1in, ppn);
+            frame_table[ppn].list = A1IN;
+        }
+    }
+
+    void frame_removed(unsigned int ppn) override {
+        frame_list_remove(frame_table[ppn].list == AM ? am : a1in, ppn);
+    }
+
+    unsigned int select_victim() override {
+        if (a1in.size > kin || am.size == 0) {
+            unsigned int ppn = a1in.head;
+
+            frame_list_remove(a1in, ppn);
+
+            a1out.push_back(page_key(ppn));
+            if (a1out.size() > kout) {
+                a1out.pop_front();
+            }
+            return ppn;
+        }
+
+        while (true) {
+            unsigned int ppn = am.head;
+
+            harvest_reference_bits(ppn);
+
+            if (frame_table[ppn].ref == 0) {
+                frame_list_remove(am, ppn);
+                return ppn;
+            }
+
+            frame_table[ppn].ref = 0;
+            frame_list_rotate(am);
+        }
+    }
+};
+
+/*
+ * LRU-K (K = 2):
+ *
+ * Evicts the page whose K-th most recent reference is oldest; pages referenced
+ * fewer than K times go first, least recently used among them. Time advances
+ * on every page brought in, and a reference seen in a frame's reference bit
+ * counts at the time it is harvested. History of evicted pages is retained for
+ * as many pages as there are frames, so a page that comes back keeps its count.
+ * Victim selection looks at every resident frame.
+ */
+class lru_k_policy_t : public replacement_policy_t {
+    static constexpr unsigned int K = 2;
+
+    struct history_t {
+        uint64_t last[K] = {};                  // most recent first, 0 = never
+    };
+
+    frame_list_t resident;
+    std::vector<history_t> history;
+    std::unordered_map<uint64_t, std::pair<history_t, std::list<uint64_t>::iterator>> retained;
+    std::list<uint64_t> retained_order;
+    uint64_t now = 0;
+
+    static void record(history_t &h, uint64_t time) {
+        if (h.last[0] == time) return;
+        for (unsigned int i = K - 1; i > 0; --i) {
+            h.last[i] = h.last[i - 1];
+        }
+        h.last[0] = time;
+    }
+
+public:
+    lru_k_policy_t() : history(MAX_PHYS_PAGES) {}
+
+    const char* name() const override { return "lru-k"; }
+
+    void frame_added(unsigned int ppn) override {
+        uint64_t key = page_key(ppn);
+
+        ++now;
+
+        auto it = retained.find(key);
+        if (it != retained.end()) {
+            history[ppn] = it->second.first;
+            retained_order.erase(it->second.second);
+            retained.erase(it);
+        }
+        else {
+            history[ppn] = history_t{};
+        }
+        record(history[ppn], now);
+
+        frame_list_push_back(resident, ppn);
+    }
+
+    void frame_removed(unsigned int ppn) override {
+        frame_list_remove(resident, ppn);
+    }
+
+    unsigned int select_victim() override {
+        unsigned int victim = resident.head;
+        unsigned int ppn = resident.head;
+
+        for (unsigned int i = 0; i < resident.size; ++i) {
+            harvest_reference_bits(ppn);
+
+            if (frame_table[ppn].ref) {
+                frame_table[ppn].ref = 0;
+                record(history[ppn], now);
+            }
+
+            auto &h = history[ppn];
+            auto &best = history[victim];
+            if (h.last[K - 1] < best.last[K - 1] ||
+                (h.last[K - 1] == best.last[K - 1] && h.last[0] < best.last[0])) {
+                victim = ppn;
+            }
+
+            ppn = frame_table[ppn].list_next;
+        }
+
+        frame_list_remove(resident, victim);
+
+        uint64_t key = page_key(victim);
+        if (retained.find(key) == retained.end()) {
+            retained_order.push_back(key);
+            retained[key] = {history[victim], std::prev(retained_order.end())};
+        }
+        if (retained_order.size() > usable_frames()) {
+            retained.erase(retained_order.front());
+            retained_order.pop_front();
+        }
+
+        return victim;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<replacement_policy_t> make_replacement_policy(const std::string &name) {
+    if (name == "clock") return std::make_unique<clock_policy_t>();
+    if (name == "clock-pro") return std::make_unique<clock_pro_policy_t>();
+    if (name == "arc") return std::make_unique<arc_policy_t>();
+    if (name == "2q") return std::make_unique<two_queue_policy_t>();
+    if (name == "lru-k") return std::make_unique<lru_k_policy_t>();
+    return nullptr;
+} // make_replacement_policy()
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "pager.h"
+
+/***************************************************************************************************
+ *                                    Page Replacement Policies                                    *
+ ***************************************************************************************************/
+
+/*
+ * frame_list_t:
+ *
+ * Circular doubly linked list of frames threaded through frame_table
+ * (list_prev / list_next), so the policies share the frame table instead of
+ * keeping their own nodes. head is the oldest frame (the hand, for a clock)
+ * and head's list_prev the newest. 0 means empty -- frame 0 is pinned and
+ * never on a list. A frame is on at most one list at a time.
+ */
+struct frame_list_t {
+    unsigned int head = 0;
+    unsigned int size = 0;
+};
+
+// Appends ppn behind the newest frame (just behind the hand, for a clock)
+void frame_list_push_back(frame_list_t &list, unsigned int ppn);
+
+// Unlinks ppn from the list, O(1)
+void frame_list_remove(frame_list_t &list, unsigned int ppn);
+
+// Moves head to the back, i.e. advances a clock hand by one frame
+void frame_list_rotate(frame_list_t &list);
+
+/*
+ * Identity of the page held by ppn that survives its eviction
+ * (swap slot, or file id and block), used for the policies' ghost entries
+ */
+uint64_t page_key(unsigned int ppn);
+
+/*
+ * replacement_policy_t:
+ *
+ * Policy behind reclaim_frames() / evict(). Every policy works on the shared
+ * frame_table and reverse maps and learns about references only through
+ * harvest_reference_bits(), so it keeps nothing but its own ordering and
+ * history of evicted pages.
+ *
+ *  >> frame_added: ppn now holds a page, its frame_table fields are set
+ *  >> frame_removed: ppn was freed without being evicted (vm_destroy, COW)
+ *  >> select_victim: picks a tracked frame to evict and stops tracking it
+ */
+class replacement_policy_t {
+public:
+    virtual ~replacement_policy_t() = default;
+
+    virtual const char* name() const = 0;
+
+    virtual void frame_added(unsigned int ppn) = 0;
+
+    virtual void frame_removed(unsigned int ppn) = 0;
+
+    virtual unsigned int select_victim() = 0;
+};
+
+/*
+ * Builds the policy called name -- "clock", "clock-pro", "arc", "2q" or "lru-k"
+ * Returns nullptr if the name is unknown. Must run after MAX_PHYS_PAGES is set.
+ */
+std::unique_ptr<replacement_policy_t> make_replacement_policy(const std::string &name);
+
+/*
+ * The active policy, chosen in vm_init from the VM_POLICY environment variable
+ * (clock if unset or unknown)
+ */
+extern std::unique_ptr<replacement_policy_t> replacement_policy;
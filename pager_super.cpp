@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cassert>
+
+#include "pager_super.h"
+#include "pager_swap.h"
+#include "pager_utils.h"
+
+unsigned int superpage_pages = 1;
+std::vector<unsigned int> free_in_run;
+
+// run single frames are taken from while it has free frames and is not whole
+static unsigned int alloc_run = 0;
+
+void free_pool_init(unsigned int memory_pages) {
+    free_in_run.assign((memory_pages + superpage_pages - 1) / superpage_pages, 0);
+    alloc_run = 0;
+
+    // frame 0 is the pinned zero page, never free
+    for (unsigned int i = 1; i < memory_pages; ++i) {
+        free_pool_add(i);
+    }
+} // free_pool_init()
+
+void free_pool_add(unsigned int ppn) {
+    // a frame freed twice would be counted twice in its run
+    assert(open_phys_pages.count(ppn) == 0);
+
+    open_phys_pages.insert(ppn);
+    ++free_in_run[ppn / superpage_pages];
+} // free_pool_add()
+
+void free_pool_remove(unsigned int ppn) {
+    open_phys_pages.erase(ppn);
+    --free_in_run[ppn / superpage_pages];
+} // free_pool_remove()
+
+unsigned int free_pool_take() {
+    assert(!open_phys_pages.empty());
+
+    unsigned int ppn = *open_phys_pages.begin();
+
+    if (superpage_pages > 1) {
+        // a whole run is broken into only when no other run has free frames left
+        if (free_in_run[alloc_run] == 0 || free_in_run[alloc_run] == superpage_pages) {
+            alloc_run = ppn / superpage_pages;
+
+            for (unsigned int run = 0; run < free_in_run.size(); ++run) {
+                if (free_in_run[run] != 0 && free_in_run[run] != superpage_pages) {
+                    alloc_run = run;
+                    break;
+                }
+            }
+        }
+
+        for (ppn = alloc_run * superpage_pages; open_phys_pages.count(ppn) == 0; ++ppn) {}
+    }
+
+    free_pool_remove(ppn);
+    return ppn;
+} // free_pool_take()
+
+// First run of frames that is entirely free, 0 if none (run 0 never is)
+static unsigned int whole_free_run() {
+    for (unsigned int run = 1; run < free_in_run.size(); ++run) {
+        if (free_in_run[run] == superpage_pages) return run;
+    }
+    return 0;
+} // whole_free_run()
+
+/*
+ * true if the superpage_pages vpns from first_vpn can be filled together:
+ * all private swap-backed pages that are not resident (on disk, in the
+ * compressed cache or on the zero page), or all non-resident blocks of one
+ * file in block order
+ */
+static bool superpage_fillable(const pcb_t &pcb, unsigned int first_vpn) {
+    const file_info_t &first = pcb.pages_on_disk[first_vpn];
+
+    for (unsigned int i = 0; i < superpage_pages; ++i) {
+        const file_info_t &disk_info = pcb.pages_on_disk[first_vpn + i];
+
+        if (!disk_info.valid || disk_info.file_backed != first.file_backed) return false;
+
+        if (disk_info.file_backed) {
+            auto &fcb = fcb_pool[disk_info.fcb];
+            auto &first_fcb = fcb_pool[first.fcb];
+
+            if (fcb.ppn != 0 || fcb.file != first_fcb.file || fcb.block != first_fcb.block + i) return false;
+        }
+        else if (pcb.rmap[first_vpn + i].frame_node != RMAP_NIL || swap_sharer_count(disk_info.block) != 1) {
+            return false;
+        }
+    }
+    return true;
+} // superpage_fillable()
+
+bool superpage_fault(unsigned int vpn) {
+    auto &pcb = process_map[current_pid];
+    unsigned int first_vpn = vpn - vpn % superpage_pages;
+
+    // the process said its accesses are scattered, the rest of the run would be read for nothing
+    if (pcb.advice[vpn] == VM_ADVICE_RANDOM) return false;
+
+    if (!superpage_fillable(pcb, first_vpn)) return false;
+
+    unsigned int run = whole_free_run();
+    if (run == 0) return false;
+
+    unsigned int first_ppn = run * superpage_pages;
+    for (unsigned int i = 0; i < superpage_pages; ++i) {
+        free_pool_remove(first_ppn + i);
+    }
+
+    // page i of the run goes in frame i of the run, vpn's first
+    unsigned int offset = vpn - first_vpn;
+    for (unsigned int k = 0; k < superpage_pages; ++k) {
+        unsigned int i = (offset + k) % superpage_pages;
+        unsigned int fcb = pcb.pages_on_disk[first_vpn + i].fcb;
+
+        bool filled = pcb.pages_on_disk[first_vpn + i].file_backed
+            ? file_block_fill(fcb, first_ppn + i)
+            : swap_page_fill(first_vpn + i, first_ppn + i);
+
+        // past the end of the file or a failed read: the frames not filled go back,
+        // whatever was filled stays as base pages
+        if (!filled) {
+            for (unsigned int j = k; j < superpage_pages; ++j) {
+                free_pool_add(first_ppn + (offset + j) % superpage_pages);
+            }
+            return k > 0;
+        }
+    }
+
+    for (unsigned int i = 0; i < superpage_pages; ++i) {
+        frame_table[first_ppn + i].super = 1;
+    }
+
+    // a file superpage is part of the process's stream over the file like any other fault,
+    // readahead goes on past the run once the stream is sequential
+    auto &disk_info = pcb.pages_on_disk[vpn];
+    if (disk_info.file_backed) {
+        file_readahead(fcb_pool[disk_info.fcb].file, fcb_pool[disk_info.fcb].block, vpn);
+    }
+    return true;
+} // superpage_fault()
+
+void superpage_split(unsigned int ppn) {
+    if (!frame_table[ppn].super) return;
+
+    unsigned int first_ppn = ppn - ppn % superpage_pages;
+    for (unsigned int i = 0; i < superpage_pages; ++i) {
+        frame_table[first_ppn + i].super = 0;
+    }
+} // superpage_split()
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+
+#include "pager.h"
+
+/***************************************************************************************************
+ *                                           Superpages                                            *
+ ***************************************************************************************************/
+
+/*
+ * superpage_pages:
+ *
+ * Pages per superpage, 1 (the default) when superpages are off. A superpage
+ * is an aligned run of superpage_pages vpns held by an aligned run of as many
+ * frames, filled by a single fault. Its frames keep their own frame_table
+ * entries and reverse maps and are marked super while the run is intact:
+ * eviction takes the whole run when none of its other pages was used
+ * recently, and anything that handles one of its pages on its own (a
+ * copy-on-write fault, an unmap, a merge, a lone eviction) splits it back
+ * into base pages first.
+ *
+ * Set by VM_SUPERPAGE (read in vm_init), rounded down to a power of two.
+ */
+extern unsigned int superpage_pages;
+
+/*
+ * Free frames in each aligned run of superpage_pages frames, kept in step
+ * with open_phys_pages by free_pool_add / free_pool_remove. Run 0 holds the
+ * pinned frame 0 and is never whole.
+ */
+extern std::vector<unsigned int> free_in_run;
+
+/*
+ * Sizes free_in_run for memory_pages frames and puts frames 1.. in the free pool
+ */
+void free_pool_init(unsigned int memory_pages);
+
+/*
+ * Adds / removes a frame of the free pool (open_phys_pages)
+ */
+void free_pool_add(unsigned int ppn);
+void free_pool_remove(unsigned int ppn);
+
+/*
+ * Takes a single frame out of the free pool, which must not be empty.
+ * With superpages on, frames come from a run that is already broken into,
+ * the same one while it lasts, so whole free runs are kept for superpages
+ */
+unsigned int free_pool_take();
+
+/*
+ * Fault on vpn of the current process, with superpages on: if the aligned
+ * run of vpns around it is all private swap-backed pages that are not
+ * resident, or all non-resident blocks of one file in block order, and a
+ * whole run of frames is free, every page of the run is filled at once.
+ * vpn is filled first; false, with nothing changed, if vpn could not be
+ * (the fault then goes the base-page way). A later page that cannot be read
+ * ends the fill there, the pages filled so far stay as base pages
+ */
+bool superpage_fault(unsigned int vpn);
+
+/*
+ * Breaks the intact superpage ppn belongs to, if any, into base pages
+ */
+void superpage_split(unsigned int ppn);
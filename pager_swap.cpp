@@ -0,0 +1,232 @@
+#include "pager_swap.h"
+#include "pager_zswap.h"
+
+#include <algorithm>
+#include <cassert>
+
+std::vector<swap_slot_t> swap_slots;
+std::vector<std::vector<pid_t>> swap_overflow;
+std::vector<uint64_t> swap_bitmap;
+unsigned int swap_map_blocks = 0;
+int overcommit_mode = OVERCOMMIT_STRICT;
+
+// recycled slots and sharer lists
+static std::vector<int> swap_slot_free_list;
+static std::vector<unsigned int> swap_overflow_free;
+
+void swap_map_init(unsigned int swap_blocks) {
+    swap_map_blocks = swap_blocks;
+    swap_bitmap.assign((swap_blocks + 63) / 64, 0);
+
+    // bits past the last block are permanently in use
+    if (swap_blocks % 64 != 0) {
+        swap_bitmap.back() = ~0ULL << (swap_blocks % 64);
+    }
+} // swap_map_init()
+
+bool swap_commit_allowed(int pages, int process_pages) {
+    switch (overcommit_mode) {
+        case OVERCOMMIT_ALWAYS:
+            return true;
+        case OVERCOMMIT_HEURISTIC:
+            // more than could ever be resident or swapped out at once
+            return static_cast<long>(process_pages) + pages <= static_cast<long>(swap_map_blocks) + MAX_PHYS_PAGES - 1;
+        default:
+            return pages <= num_swap_block_available;
+    }
+} // swap_commit_allowed()
+
+bool swap_block_free(int block) {
+    if (block < 0 || static_cast<unsigned int>(block) >= swap_map_blocks) return false;
+
+    return !(swap_bitmap[block / 64] >> (block % 64) & 1);
+} // swap_block_free()
+
+static void swap_take(int block) {
+    swap_bitmap[block / 64] |= 1ULL << (block % 64);
+} // swap_take()
+
+static int swap_alloc(int hint) {
+    // extend the caller's run
+    if (swap_block_free(hint)) {
+        swap_take(hint);
+        return hint;
+    }
+
+    // open a new cluster -- SWAP_CLUSTER divides 64, so a cluster never spans two words
+    static_assert(64 % SWAP_CLUSTER == 0);
+    const uint64_t cluster_mask = SWAP_CLUSTER == 64 ? ~0ULL : (1ULL << SWAP_CLUSTER) - 1;
+
+    for (size_t w = 0; w < swap_bitmap.size(); ++w) {
+        if (swap_bitmap[w] == ~0ULL) continue;
+
+        for (unsigned int c = 0; c < 64; c += SWAP_CLUSTER) {
+            if ((swap_bitmap[w] >> c & cluster_mask) == 0) {
+                int block = static_cast<int>(w * 64 + c);
+                swap_take(block);
+                return block;
+            }
+        }
+    }
+
+    // fragmented, take the lowest free block
+    for (size_t w = 0; w < swap_bitmap.size(); ++w) {
+        if (swap_bitmap[w] == ~0ULL) continue;
+
+        int block = static_cast<int>(w * 64) + __builtin_ctzll(~swap_bitmap[w]);
+        swap_take(block);
+        return block;
+    }
+
+    return -1;
+} // swap_alloc()
+
+static void swap_release_block(swap_slot_t &slot) {
+    if (slot.block == -1) return;
+
+    swap_bitmap[slot.block / 64] &= ~(1ULL << (slot.block % 64));
+    slot.block = -1;
+} // swap_release_block()
+
+int swap_slot_alloc() {
+    int slot;
+
+    if (!swap_slot_free_list.empty()) {
+        slot = swap_slot_free_list.back();
+        swap_slot_free_list.pop_back();
+    }
+    else {
+        slot = static_cast<int>(swap_slots.size());
+        swap_slots.emplace_back();
+    }
+
+    swap_slots[slot] = swap_slot_t{};
+    return slot;
+} // swap_slot_alloc()
+
+static void swap_overflow_release(swap_slot_t &s) {
+    if (s.overflow == SWAP_NO_OVERFLOW) return;
+
+    swap_overflow[s.overflow].clear();
+    swap_overflow_free.push_back(s.overflow);
+    s.overflow = SWAP_NO_OVERFLOW;
+} // swap_overflow_release()
+
+void swap_sharer_add(int slot, pid_t pid) {
+    auto &s = swap_slots[slot];
+    assert(!swap_sharer_has(slot, pid));
+
+    if (s.sharers == 0) {
+        s.owner = pid;
+    }
+    else {
+        // second sharer: the slot gets a list, starting with the inline owner
+        if (s.sharers == 1) {
+            if (!swap_overflow_free.empty()) {
+                s.overflow = swap_overflow_free.back();
+                swap_overflow_free.pop_back();
+            }
+            else {
+                s.overflow = static_cast<unsigned int>(swap_overflow.size());
+                swap_overflow.emplace_back();
+            }
+            swap_overflow[s.overflow].push_back(s.owner);
+        }
+        swap_overflow[s.overflow].push_back(pid);
+    }
+    ++s.sharers;
+} // swap_sharer_add()
+
+void swap_sharer_remove(int slot, pid_t pid) {
+    auto &s = swap_slots[slot];
+
+    if (s.sharers <= 1) {
+        assert(s.sharers == 1 && s.owner == pid);
+        s.sharers = 0;
+        return;
+    }
+
+    auto &list = swap_overflow[s.overflow];
+    auto it = std::find(list.begin(), list.end(), pid);
+    assert(it != list.end());
+
+    *it = list.back();
+    list.pop_back();
+    --s.sharers;
+
+    // back to one sharer, it goes inline again
+    if (s.sharers == 1) {
+        s.owner = list.front();
+        swap_overflow_release(s);
+    }
+} // swap_sharer_remove()
+
+unsigned int swap_sharer_count(int slot) {
+    return swap_slots[slot].sharers;
+} // swap_sharer_count()
+
+bool swap_sharer_has(int slot, pid_t pid) {
+    for (pid_t sharer : swap_sharers(slot)) {
+        if (sharer == pid) return true;
+    }
+    return false;
+} // swap_sharer_has()
+
+swap_sharer_range_t swap_sharers(int slot) {
+    auto &s = swap_slots[slot];
+
+    if (s.sharers <= 1) {
+        return {&s.owner, &s.owner + s.sharers};
+    }
+
+    auto &list = swap_overflow[s.overflow];
+    return {list.data(), list.data() + list.size()};
+} // swap_sharers()
+
+void swap_slot_free(int slot) {
+    zswap_drop(slot);
+    swap_release_block(swap_slots[slot]);
+    swap_overflow_release(swap_slots[slot]);
+    swap_slots[slot].sharers = 0;
+
+    swap_slot_free_list.push_back(slot);
+} // swap_slot_free()
+
+bool swap_slot_zero(int slot) {
+    return swap_slots[slot].zero != 0;
+} // swap_slot_zero()
+
+void swap_mark_written(int slot) {
+    swap_slots[slot].zero = 0;
+} // swap_mark_written()
+
+void swap_mark_zero(int slot) {
+    zswap_drop(slot);
+    swap_release_block(swap_slots[slot]);
+
+    swap_slots[slot].zero = 1;
+} // swap_mark_zero()
+
+int swap_slot_block(int slot, int hint) {
+    auto &s = swap_slots[slot];
+
+    if (s.block == -1) {
+        s.block = swap_alloc(hint);
+    }
+    return s.block;
+} // swap_slot_block()
+
+int swap_hint(const pcb_t &pcb, unsigned int vpn) {
+    auto block_of = [&](unsigned int v) {
+        auto &disk_info = pcb.pages_on_disk[v];
+        return disk_info.valid && !disk_info.file_backed ? swap_slots[disk_info.block].block : -1;
+    };
+
+    if (vpn > 0 && block_of(vpn - 1) != -1) {
+        return block_of(vpn - 1) + 1;
+    }
+    if (vpn + 1 < pcb.next_vm_page && block_of(vpn + 1) != -1) {
+        return block_of(vpn + 1) - 1;
+    }
+    return -1;
+} // swap_hint()
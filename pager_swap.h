@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+
+#include "pager.h"
+
+/***************************************************************************************************
+ *                                  Swap Slots and Block Allocator                                 *
+ ***************************************************************************************************/
+
+/*
+ * swap_slot_t:
+ *
+ * A slot stands for the contents of one swap-backed page. It is what
+ * pages_on_disk[vpn].block, a frame's block and the compressed cache refer
+ * to. The swap block holding the contents on disk is bound lazily, the first
+ * time the page has to be written out, so a page that stays in memory, in
+ * the compressed cache or all zeros never uses one.
+ *
+ * The slot also counts the processes sharing it (copy-on-write, at the same
+ * vpn). The usual single sharer is kept inline; only while there are several
+ * does the slot own a list of them in swap_overflow.
+ */
+static constexpr unsigned int SWAP_NO_OVERFLOW = 0xFFFFFFFF;
+
+struct swap_slot_t {
+    int block = -1;                             // swap block holding the contents -- -1 if none yet
+    int zero = 1;                               // contents are all zeros (never written, or written as zeros)
+    pid_t owner = 0;                            // the sharer while there is exactly one
+    unsigned int sharers = 0;                   // number of processes sharing the slot
+    unsigned int overflow = SWAP_NO_OVERFLOW;   // swap_overflow list of every sharer while there are several
+};
+
+extern std::vector<swap_slot_t> swap_slots;
+extern std::vector<std::vector<pid_t>> swap_overflow;
+
+/*
+ * swap_sharer_range_t:
+ *
+ * The sharers of a slot, for range-for. Invalidated by any change to the slot's sharers.
+ */
+struct swap_sharer_range_t {
+    const pid_t* first;
+    const pid_t* last;
+
+    const pid_t* begin() const { return first; }
+    const pid_t* end() const { return last; }
+};
+
+/*
+ * swap_bitmap:
+ *
+ * One bit per swap block, set while the block is in use. Blocks are handed
+ * out in aligned clusters of SWAP_CLUSTER: a process's first swap page opens
+ * a free cluster and each following page asks for the block after its
+ * neighbour's, so adjacent vpns of a process land in adjacent swap blocks
+ * and faults / writebacks on neighbours turn into sequential I/O.
+ */
+static constexpr unsigned int SWAP_CLUSTER = 16;
+
+// most blocks moved by one swap-in readahead / one coalesced writeback run
+static constexpr unsigned int SWAP_RUN = 4;
+
+extern std::vector<uint64_t> swap_bitmap;
+
+/*
+ * overcommit_mode:
+ *
+ * How many swap-backed pages vm_map / vm_create may promise (VM_OVERCOMMIT at vm_init).
+ * Every page is charged to num_swap_block_available either way:
+ *  >> OVERCOMMIT_STRICT: charges never exceed the swap file, so a page always
+ *     finds a block when it is written out (the default)
+ *  >> OVERCOMMIT_HEURISTIC: refuses only a process charged more pages than
+ *     there are swap blocks and frames together
+ *  >> OVERCOMMIT_ALWAYS: never refuses
+ *
+ * Past strict, writeback can find the swap file full: the page then stays
+ * resident and dirty, evict() gives up on it, and a fault that cannot get
+ * its frames from any other victim fails with -1.
+ */
+static constexpr int OVERCOMMIT_STRICT = 0;
+static constexpr int OVERCOMMIT_HEURISTIC = 1;
+static constexpr int OVERCOMMIT_ALWAYS = 2;
+
+extern int overcommit_mode;
+
+/*
+ * Sizes the bitmap to swap_blocks free blocks, called from vm_init
+ */
+void swap_map_init(unsigned int swap_blocks);
+
+/*
+ * true if a process already charged process_pages swap-backed pages
+ * may be charged pages more under overcommit_mode
+ */
+bool swap_commit_allowed(int pages, int process_pages);
+
+/*
+ * Sharer accounting of a slot: add / remove a process, how many share it,
+ * whether pid is one of them and the list of them
+ */
+void swap_sharer_add(int slot, pid_t pid);
+void swap_sharer_remove(int slot, pid_t pid);
+unsigned int swap_sharer_count(int slot);
+bool swap_sharer_has(int slot, pid_t pid);
+swap_sharer_range_t swap_sharers(int slot);
+
+/*
+ * New slot reading as zeros with no block and no sharers, never fails
+ */
+int swap_slot_alloc();
+
+/*
+ * Frees slot along with its block, its compressed copy and its sharer list
+ */
+void swap_slot_free(int slot);
+
+/*
+ * true if slot's contents are all zeros, there is nothing to read back
+ */
+bool swap_slot_zero(int slot);
+
+/*
+ * Records that slot's contents now live in its block or in the compressed cache
+ */
+void swap_mark_written(int slot);
+
+/*
+ * Records that slot reads as zeros again, its block and compressed copy are released
+ */
+void swap_mark_zero(int slot);
+
+/*
+ * slot's block, bound on first use: hint if it is free, else the start of
+ * the lowest free cluster, else the lowest free block
+ * Returns -1 if the swap file is full
+ */
+int swap_slot_block(int slot, int hint);
+
+/*
+ * true if block is a valid block that is not in use
+ */
+bool swap_block_free(int block);
+
+/*
+ * Block right after the one holding the swap page at vpn - 1 of pcb
+ * (else right before the one at vpn + 1), -1 if neither has a block
+ */
+int swap_hint(const pcb_t &pcb, unsigned int vpn);
@@ -1,176 +1,529 @@
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <iostream>
-#include <memory>
 #include <cstring>
+#include <cstdint>
+#include <iterator>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include "pager_utils.h"
+#include "pager_policy.h"
+#include "pager_swap.h"
+#include "pager_zswap.h"
+#include "pager_fcb.h"
+#include "pager_super.h"
 
 // file_backed_fault
-int file_backed_fault(page_table_entry_t &pte, file_info_t &disk_info, unsigned int next_page,
+int file_backed_fault(page_table_entry_t &pte, const file_info_t &disk_info, unsigned int next_page,
     void* destination, unsigned int vpn) {
 
     // check_states();
 
-    auto &fname = disk_info.filename;
+    unsigned int fcb = disk_info.fcb;
+    unsigned int file = fcb_pool[fcb].file;
     auto &block = disk_info.block;
 
-    if (file_read(fname.data(), block, destination) == -1) return -1; 
+    if (file_read(file_names[file].c_str(), block, destination) == -1) {
+        release_frame(next_page);
+        return -1;
+    }
 
     // Shared file-backed page -> step 2
-    auto &block_mapping = file_backed_pages[fname].block_to_file[block];
+    auto &block_mapping = fcb_pool[fcb];
     block_mapping.ppn = next_page;
 
     // Set all shared file back pages to same ppn
-    size_t n = block_mapping.ptes.size();
-    for (size_t i = 0; i < n; i++) {
-        
-        auto pair = block_mapping.ptes.front();
-        block_mapping.ptes.pop();
-
-        block_mapping.ptes.push(pair);
+    for (unsigned int n = block_mapping.ptes.head; n != RMAP_NIL; n = rmap_pool[n].next) {
+        pid_t pid = rmap_pool[n].pid;
+        unsigned int pte_vpn = rmap_pool[n].vpn;
 
-        auto &pte_temp = process_map[pair.first].page_table[pair.second];
+        auto &pte_temp = process_map[pid].page_table[pte_vpn];
 
         set_pte_bits(pte_temp, next_page, 1, 1, 0, 0);
 
-        page_map[next_page]->ptes.push(pair);
+        frame_rmap_add(next_page, pid, pte_vpn);
     }
 
     // Update state of phys memory
-    page_map[next_page]->file_backed    = 1;
-    page_map[next_page]->block          = block;
-    page_map[next_page]->filename       = fname;
-    page_map[next_page]->ref            = 0;
-    page_map[next_page]->dirty          = 0;
+    install_frame(next_page, 1, block, fcb, 0);
+
+    file_readahead(file, static_cast<unsigned int>(block), vpn);
 
     // check_states();
     return 0;
 }
 
+void file_readahead(unsigned int file, unsigned int block, unsigned int vpn) {
+    static constexpr unsigned int RA_MIN_WINDOW = 2;
+
+    auto &pcb = process_map[current_pid];
+    auto &stream = pcb.readahead[file];
+    unsigned int max_window = std::max(1u, (MAX_PHYS_PAGES - 1) / 4);
+
+    // the process said how it reads these pages, no need to guess
+    if (pcb.advice[vpn] == VM_ADVICE_SEQUENTIAL) {
+        stream.window = max_window;
+    }
+    else if (pcb.advice[vpn] != VM_ADVICE_RANDOM && block == stream.next_block) {
+        stream.window = std::min(std::max(RA_MIN_WINDOW, stream.window * 2), max_window);
+    }
+    else {
+        stream.window = 0;
+    }
+    stream.next_block = block + 1;
+
+    // only free and drop-behind frames are used, readahead never evicts the working set
+    for (unsigned int i = 1; i <= stream.window && spare_frame_available(0); ++i) {
+        unsigned int handle = fcb_get(file, block + i);
+
+        // past the end of the file
+        if (fcb_pool[handle].ppn == 0 && !file_block_prefetch(handle)) {
+            if (fcb_pool[handle].ptes.size == 0) fcb_erase(handle);
+            break;
+        }
+
+        // resident up to here, the stream's next fault is past it
+        stream.next_block = block + i + 1;
+    }
+} // file_readahead()
+
+bool file_block_prefetch(unsigned int handle) {
+    unsigned int ppn = get_next_ppn();
+
+    if (!file_block_fill(handle, ppn)) {
+        release_frame(ppn);
+        return false;
+    }
+    return true;
+} // file_block_prefetch()
+
+bool file_block_fill(unsigned int handle, unsigned int ppn) {
+    auto &fcb = fcb_pool[handle];
+
+    if (file_read(file_names[fcb.file].c_str(), fcb.block, BASE_ADDR + (static_cast<size_t>(ppn) * VM_PAGESIZE)) == -1) {
+        return false;
+    }
+
+    fcb.ppn = ppn;
+
+    // anyone who already mapped the block sees it resident right away
+    for (unsigned int n = fcb.ptes.head; n != RMAP_NIL; n = rmap_pool[n].next) {
+        set_pte_bits(process_map[rmap_pool[n].pid].page_table[rmap_pool[n].vpn], ppn, 1, 1, 0, 0);
+        frame_rmap_add(ppn, rmap_pool[n].pid, rmap_pool[n].vpn);
+    }
+
+    // unreferenced, so it is among the first to go if nobody touches it
+    install_frame(ppn, 1, static_cast<int>(fcb.block), handle, 0);
+    return true;
+} // file_block_fill()
+
+void release_page(unsigned int vpn) {
+    auto &pcb = process_map[current_pid];
+    auto &pte = pcb.page_table[vpn];
+    const file_info_t &file_info = pcb.pages_on_disk[vpn];
+
+    // drop this pte from the reverse map of its resident frame,
+    // its reference and dirty bits are folded into the frame first
+    if (pcb.rmap[vpn].frame_node != RMAP_NIL) {
+        unsigned int ppn = pte.ppage;
+
+        frame_rmap_remove(ppn, current_pid, vpn);
+
+        // clear and set free the phys_page if it only was for this process,
+        // a file-backed one stays cached for its block
+        if (frame_info[ppn].ptes.size == 0 && !frame_table[ppn].file_backed) {
+            release_frame(ppn);
+        }
+    }
+
+    if (!file_info.file_backed) {
+        swap_sharer_remove(file_info.block, current_pid);
+
+        if (swap_sharer_count(file_info.block) == 0) {
+            swap_slot_free(file_info.block);
+        }
+        else if (swap_sharer_count(file_info.block) == 1) {
+            auto last_pid = *swap_sharers(file_info.block).begin();
+
+            auto &pte_swap = process_map[last_pid].page_table[vpn];
+
+            // the last sharer left on a resident frame can write to it again
+            if (pte_swap.read_enable && pte_swap.ppage != 0) {
+                set_pte_bits(pte_swap, -1, 1, 1, -1, -1);
+            }
+        }
+    }
+    else {
+        auto &fcb = fcb_pool[file_info.fcb];
+
+        file_rmap_remove(fcb, current_pid, vpn);
+
+        // mapped by nobody and not cached, the block needs no index entry anymore
+        if (fcb.ptes.size == 0 && fcb.ppn == 0) {
+            fcb_erase(file_info.fcb);
+        }
+    }
+
+    set_pte_bits(pte, 0, 0, 0, 0, 0);
+} // release_page()
+
+unsigned int vpn_range_find(const pcb_t &pcb, unsigned int count) {
+    // free ranges in vpn order, so the first that fits is the lowest
+    for (auto &[start, length] : pcb.free_vpns) {
+        if (length >= count) return start;
+    }
+
+    return count <= NUM_VPAGES - pcb.next_vm_page ? pcb.next_vm_page : NUM_VPAGES;
+} // vpn_range_find()
+
+void vpn_range_take(pcb_t &pcb, unsigned int vpn, unsigned int count) {
+    if (vpn == pcb.next_vm_page) {
+        pcb.next_vm_page += count;
+        return;
+    }
+
+    auto it = pcb.free_vpns.find(vpn);
+    unsigned int length = it->second;
+
+    pcb.free_vpns.erase(it);
+    if (length > count) {
+        pcb.free_vpns[vpn + count] = length - count;
+    }
+} // vpn_range_take()
+
+void vpn_range_free(pcb_t &pcb, unsigned int vpn, unsigned int count) {
+    unsigned int start = vpn;
+    unsigned int end = vpn + count;
+
+    // merge with the free ranges on either side
+    auto next = pcb.free_vpns.find(end);
+    if (next != pcb.free_vpns.end()) {
+        end += next->second;
+        pcb.free_vpns.erase(next);
+    }
+
+    auto it = pcb.free_vpns.lower_bound(start);
+    if (it != pcb.free_vpns.begin() && std::prev(it)->first + std::prev(it)->second == start) {
+        start = std::prev(it)->first;
+        pcb.free_vpns.erase(std::prev(it));
+    }
+
+    // nothing is mapped from start up anymore, the arena shrinks back instead
+    if (end == pcb.next_vm_page) {
+        pcb.next_vm_page = start;
+    }
+    else {
+        pcb.free_vpns[start] = end - start;
+    }
+} // vpn_range_free()
+
 // swap file reservation -> copy on write
-void swap_block_reservation(int &block) {
-    swap_file[block].erase(current_pid);
+int swap_block_reservation(unsigned int vpn) {
+    auto &block = process_map[current_pid].pages_on_disk.mut(vpn).block;
 
-    // reserve block
-    unsigned int p = *open_swap_pages.begin();
+    swap_sharer_remove(block, current_pid);
 
-    open_swap_pages.erase(p);
+    // a private slot, its block is bound when the copy is first written out
+    int p = swap_slot_alloc();
 
     block = p;
 
-    swap_file[block].insert(current_pid);
+    swap_sharer_add(block, current_pid);
+    return p;
 }
 
 // swap back fault in phys memory
-int swap_back_fault_in_memory(page_table_entry_t &pte, file_info_t &disk_info, unsigned int vpn) {
+int swap_back_fault_in_memory(page_table_entry_t &pte, const file_info_t &disk_info, unsigned int vpn) {
+    // The other sharers are gone or have their own copies: the frame and slot are ours, upgrade in place
+    if (sole_swap_owner(pte, disk_info)) {
+        set_pte_bits(pte, -1, 1, 1, -1, 1);
+        return 0;
+    }
+
     // Make sure ref is set to correct value before eviction
     if (pte.ppage != 0) {
-        int n = page_map[pte.ppage]->ptes.size();
+        auto &ptes = frame_info[pte.ppage].ptes;
 
-        for (int i=0; i<n; i++){
-            auto p = page_map[pte.ppage]->ptes.front();
-            page_map[pte.ppage]->ptes.pop();
+        frame_rmap_remove(pte.ppage, current_pid, vpn);
 
-            auto &pte_swap = process_map[p.first].page_table[p.second];
-
-            if (p.first == current_pid && p.second == vpn) {
-                continue;
-            }
+        for (unsigned int n = ptes.head; n != RMAP_NIL; n = rmap_pool[n].next) {
+            auto &pte_swap = process_map[rmap_pool[n].pid].page_table[rmap_pool[n].vpn];
 
             pte_swap.referenced = 1;
-
-            page_map[pte.ppage]->ptes.push(p);
         }
     }
 
+    unsigned int old_page = pte.ppage;
     unsigned int next_page = get_next_ppn();
 
+    // get_next_ppn() does not evict, so the old frame is still there to copy from
+    assert(next_page != old_page);
+
     void* destination = BASE_ADDR + (static_cast<size_t>(next_page * VM_PAGESIZE));
 
-    std::memcpy(
-        destination, // destination
-        BASE_ADDR + (static_cast<size_t>(pte.ppage * VM_PAGESIZE)), // Source is the zero pinned page
-        VM_PAGESIZE
-    );
+    // First write to a zero page: clear the frame instead of copying 64 KiB of zeros out of frame 0
+    if (old_page == 0) {
+        zero_fill_page(destination);
+    }
+    else {
+        std::memcpy(
+            destination, // destination
+            BASE_ADDR + (static_cast<size_t>(old_page * VM_PAGESIZE)), // Source is the shared frame
+            VM_PAGESIZE
+        );
+    }
 
-    if (pte.ppage != 0) {
-        if (page_map[pte.ppage]->ptes.size() == 1) {
-            auto &t = page_map[pte.ppage]->ptes.front();
+    if (old_page != 0) {
+        // nobody else maps the old frame anymore
+        if (frame_info[pte.ppage].ptes.size == 0) {
+            release_frame(pte.ppage);
+        }
+        else if (frame_info[pte.ppage].ptes.size == 1) {
+            auto &t = rmap_pool[frame_info[pte.ppage].ptes.head];
 
             // Change write bit of old page to 1 because not being shared anymore
-            process_map[t.first].page_table[t.second].write_enable = 1;
+            process_map[t.pid].page_table[t.vpn].write_enable = 1;
         }
     }
 
     // assert(disk_info.valid);
+    int slot = disk_info.block;
 
-    if (swap_file[disk_info.block].size() > 1) {
-        swap_block_reservation(disk_info.block);
+    if (swap_sharer_count(slot) > 1) {
+        slot = swap_block_reservation(vpn);
     }
 
     set_pte_bits(pte, next_page, 1, 1, 0, 0);
 
     // ensure its swap block is set correctly
-    page_map[next_page]->block          = disk_info.block;
-    page_map[next_page]->file_backed    = 0;
-    page_map[next_page]->ref            = 0;
-    page_map[next_page]->dirty          = 0;
+    install_frame(next_page, 0, slot, FCB_NIL, 0);
 
-    page_map[next_page]->ptes.emplace(current_pid, vpn);
+    // a private copy in a fresh slot exists nowhere else yet
+    if (old_page != 0 && swap_slot_zero(slot)) {
+        frame_table[next_page].dirty = 1;
+    }
+
+    frame_rmap_add(next_page, current_pid, vpn);
 
     // check_states();
     return 0;
 }
 
-int swap_back_disk(page_table_entry_t &pte, file_info_t &disk_info, unsigned int next_page,
+int swap_back_disk(page_table_entry_t &pte, const file_info_t &disk_info, unsigned int next_page,
     void* destination, bool write_flag, unsigned int vpn) {
 
     // std::cout << "swap_back_disk" << std::endl; 
     // check_states();
 
-    if (file_read(nullptr, disk_info.block, destination) == -1) return -1;
+    // a slot that was never written holds nothing, there is no need to read it
+    if (swap_slot_zero(disk_info.block)) {
+        zero_fill_page(destination);
+    }
+    // then the compressed cache, the swap file last
+    else if (!zswap_load(disk_info.block, destination)
+        && file_read(nullptr, swap_slots[disk_info.block].block, destination) == -1) {
+        release_frame(next_page);
+        return -1;
+    }
 
     // swap file block reservation
-    // std::cout << "disk info block size: " << swap_file[disk_info.block].size() << std::endl;
-    if (swap_file[disk_info.block].size() > 1) { 
-        for (auto &pid : swap_file[disk_info.block]) {
+    // std::cout << "disk info block size: " << swap_sharer_count(disk_info.block) << std::endl;
+    if (swap_sharer_count(disk_info.block) > 1) { 
+        for (auto &pid : swap_sharers(disk_info.block)) {
 
             auto &pte_swap = process_map[pid].page_table[vpn];
             
             set_pte_bits(pte_swap, next_page, 1, 0, 0, static_cast<int>(write_flag));
             
             if (pid != current_pid) {
-                page_map[next_page]->ptes.emplace(pid, vpn);
+                frame_rmap_add(next_page, pid, vpn);
             }
         }
         // std::cout<< "LOOP END\n";
-        // set page state
-        page_map[next_page]->ref          = static_cast<int>(write_flag);
-        page_map[next_page]->block        = disk_info.block;
-        page_map[next_page]->file_backed  = 0;
-        page_map[next_page]->dirty        = 0;
+        int shared_block = disk_info.block;
 
+        // the shared frame is handed to the replacement policy only after the
+        // copy has its own frame, so that allocation cannot evict it
         if (write_flag) {
             copy_on_write_disk(pte, disk_info, next_page, destination, write_flag, vpn);
         }
+
+        // set page state
+        install_frame(next_page, 0, shared_block, FCB_NIL, static_cast<int>(write_flag));
     }
     else {
         set_pte_bits(pte, next_page, 1, 1, 0, 0);
 
-        page_map[next_page]->ref          = 0;
-        page_map[next_page]->block        = disk_info.block;
-        page_map[next_page]->file_backed  = 0;
-        page_map[next_page]->dirty        = 0;
+        install_frame(next_page, 0, disk_info.block, FCB_NIL, 0);
     }     
 
-    page_map[pte.ppage]->ptes.emplace(current_pid, vpn);
+    frame_rmap_add(pte.ppage, current_pid, vpn);
+
+    swap_readahead(vpn);
 
     // check_states();
     return 0;
 }
 
-void copy_on_write_disk(page_table_entry_t &pte, file_info_t &disk_info, unsigned int next_page,
+void swap_readahead(unsigned int vpn) {
+    auto &pcb = process_map[current_pid];
+    int block = swap_slots[pcb.pages_on_disk[vpn].block].block;
+
+    // the neighbours of a randomly accessed page are no more likely to be next than any other
+    if (pcb.advice[vpn] == VM_ADVICE_RANDOM) return;
+
+    // only free and drop-behind frames are used, readahead never evicts the working set
+    for (unsigned int i = 1; i < SWAP_RUN && vpn + i < pcb.next_vm_page && spare_frame_available(0); ++i) {
+        auto &disk_info = pcb.pages_on_disk[vpn + i];
+        auto &pte = pcb.page_table[vpn + i];
+
+        // the run ends at the first page that is not private, on disk and zero or in the next block
+        if (!disk_info.valid || disk_info.file_backed || pte.read_enable) break;
+        if (swap_sharer_count(disk_info.block) != 1) break;
+
+        int zero = swap_slot_zero(disk_info.block);
+        if (!zero && (block == -1 || swap_slots[disk_info.block].block != block + static_cast<int>(i))) break;
+
+        if (!swap_page_prefetch(vpn + i)) break;
+    }
+} // swap_readahead()
+
+bool swap_page_prefetch(unsigned int vpn) {
+    unsigned int ppn = get_next_ppn();
+
+    if (!swap_page_fill(vpn, ppn)) {
+        release_frame(ppn);
+        return false;
+    }
+    return true;
+} // swap_page_prefetch()
+
+bool swap_page_fill(unsigned int vpn, unsigned int ppn) {
+    int slot = process_map[current_pid].pages_on_disk[vpn].block;
+
+    void* destination = BASE_ADDR + (static_cast<size_t>(ppn) * VM_PAGESIZE);
+
+    if (swap_slot_zero(slot)) {
+        zero_fill_page(destination);
+    }
+    else if (!zswap_load(slot, destination)
+        && file_read(nullptr, swap_slots[slot].block, destination) == -1) {
+        return false;
+    }
+
+    // the sharers all map the frame, writable only if nobody else does
+    int private_slot = swap_sharer_count(slot) == 1;
+    for (pid_t pid : swap_sharers(slot)) {
+        set_pte_bits(process_map[pid].page_table[vpn], ppn, 1, private_slot, 0, 0);
+        frame_rmap_add(ppn, pid, vpn);
+    }
+
+    // unreferenced, so it is among the first to go if the process never touches it
+    install_frame(ppn, 0, slot, FCB_NIL, 0);
+    return true;
+} // swap_page_fill()
+
+void willneed_prefetch(unsigned int vpn, unsigned int count) {
+    auto &pcb = process_map[current_pid];
+
+    // free and drop-behind frames only: vm_fault does not reclaim while reclaim_low of them are left
+    for (unsigned int i = vpn; i < vpn + count && spare_frame_available(reclaim_low); ++i) {
+        auto &disk_info = pcb.pages_on_disk[i];
+
+        if (!disk_info.valid) continue;
+
+        if (disk_info.file_backed) {
+            if (fcb_pool[disk_info.fcb].ppn == 0) file_block_prefetch(disk_info.fcb);
+        }
+        // on disk, not resident and not the zero page
+        else if (!pcb.page_table[i].read_enable) {
+            swap_page_prefetch(i);
+        }
+    }
+} // willneed_prefetch()
+
+void drop_behind(unsigned int vpn) {
+    auto &pcb = process_map[current_pid];
+
+    // newest first, the walk ends where the previous fault's walk stopped
+    for (unsigned int i = vpn; i-- > 0 && pcb.advice[i] == VM_ADVICE_SEQUENTIAL; ) {
+        if (pcb.rmap[i].frame_node == RMAP_NIL) break;
+
+        unsigned int ppn = pcb.page_table[i].ppage;
+        auto &page = frame_table[ppn];
+        if (page.drop_behind || !page.tracked) break;
+
+        // fold the references so far into the frame: a pte referenced again later means the page is still in use
+        harvest_reference_bits(ppn);
+
+        page.drop_behind = 1;
+        frame_info[ppn].drop_node = drop_behind_frames.insert(drop_behind_frames.end(), ppn);
+    }
+} // drop_behind()
+
+void discard_pages(unsigned int vpn, unsigned int count) {
+    auto &pcb = process_map[current_pid];
+
+    for (unsigned int i = vpn; i < vpn + count; ++i) {
+        auto &disk_info = pcb.pages_on_disk[i];
+        auto &pte = pcb.page_table[i];
+
+        if (!disk_info.valid || disk_info.file_backed) continue;
+
+        int slot = disk_info.block;
+
+        // copy-on-write sharers still need the contents: this process lets go of the slot and reads zeros from now on
+        if (swap_sharer_count(slot) > 1) {
+            if (pcb.rmap[i].frame_node != RMAP_NIL) {
+                unsigned int ppn = pte.ppage;
+
+                frame_rmap_remove(ppn, current_pid, i);
+                if (frame_info[ppn].ptes.size == 0) release_frame(ppn);
+            }
+
+            swap_block_reservation(i);
+
+            // the last sharer left on a resident frame can write to it again
+            if (swap_sharer_count(slot) == 1) {
+                auto &pte_swap = process_map[*swap_sharers(slot).begin()].page_table[i];
+
+                if (pte_swap.read_enable && pte_swap.ppage != 0) {
+                    set_pte_bits(pte_swap, -1, 1, 1, -1, -1);
+                }
+            }
+
+            set_pte_bits(pte, 0, 1, 0, 0, 0);
+            continue;
+        }
+
+        // on disk or in the compressed cache: nothing to wait for, the slot reads as zeros right away
+        if (pcb.rmap[i].frame_node == RMAP_NIL) {
+            swap_mark_zero(slot);
+            set_pte_bits(pte, 0, 1, 0, 0, 0);
+            continue;
+        }
+
+        // resident: kept until reclaim wants the frame, and kept for good if the process writes to it first.
+        // The frame is clean from here on, so a later write shows up in the pte's dirty bit
+        unsigned int ppn = pte.ppage;
+        auto &page = frame_table[ppn];
+
+        pte.dirty = 0;
+        page.dirty = 0;
+        page.lazy_free = 1;
+
+        if (!page.drop_behind && page.tracked) {
+            page.drop_behind = 1;
+            frame_info[ppn].drop_node = drop_behind_frames.insert(drop_behind_frames.end(), ppn);
+        }
+    }
+} // discard_pages()
+
+void copy_on_write_disk(page_table_entry_t &pte, const file_info_t &disk_info, unsigned int next_page,
     void* destination, bool write_flag, unsigned int vpn) {
 
     // std::cout << "copy_on_write_disk\n";
@@ -178,11 +531,11 @@ void copy_on_write_disk(page_table_entry_t &pte, file_info_t &disk_info, unsigne
     int old_block = disk_info.block;
 
     // assert(disk_info.valid);
-    swap_block_reservation(disk_info.block);
+    int slot = swap_block_reservation(vpn);
 
     // if one page left then write enabled
-    if (swap_file[old_block].size() == 1) {
-        auto last_pid = *swap_file[old_block].begin();
+    if (swap_sharer_count(old_block) == 1) {
+        auto last_pid = *swap_sharers(old_block).begin();
 
         auto &pte_swap = process_map[last_pid].page_table[vpn];
         set_pte_bits(pte_swap, next_page, 1, 1, 0, 1);
@@ -201,12 +554,83 @@ void copy_on_write_disk(page_table_entry_t &pte, file_info_t &disk_info, unsigne
     set_pte_bits(pte, swap_next_page, 1, 1, 0, 0);
 
     // ensure its swap block is set correctly
-    page_map[pte.ppage]->block          = disk_info.block;
-    page_map[pte.ppage]->file_backed    = 0;
-    page_map[pte.ppage]->ref            = 0;
-    page_map[pte.ppage]->dirty          = 0;
+    install_frame(swap_next_page, 0, slot, FCB_NIL, 0);
+
+    // the copy's fresh slot holds nothing yet, it must be written if evicted
+    frame_table[swap_next_page].dirty = 1;
 } //copy_on_write_disk
 
+bool sole_swap_owner(const page_table_entry_t &pte, const file_info_t &disk_info) {
+    return !disk_info.file_backed && pte.read_enable && pte.ppage != 0
+        && swap_sharer_count(disk_info.block) == 1 && frame_info[pte.ppage].ptes.size == 1;
+} // sole_swap_owner()
+
+void zero_fill_page(void* page) {
+    // glibc's memset picks the widest vector stores the cpu has (AVX2 / ERMS)
+    // and keeps the lines cached for the write that caused the fault
+    std::memset(page, 0, VM_PAGESIZE);
+} // zero_fill_page()
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static bool page_is_zero_avx2(const unsigned char* p) {
+    // 256 bytes per step, so a page with data usually exits on the first one
+    for (size_t i = 0; i < VM_PAGESIZE; i += 256) {
+        auto v = reinterpret_cast<const __m256i*>(p + i);
+        __m256i acc = _mm256_or_si256(
+            _mm256_or_si256(_mm256_loadu_si256(v + 0), _mm256_loadu_si256(v + 1)),
+            _mm256_or_si256(_mm256_loadu_si256(v + 2), _mm256_loadu_si256(v + 3)));
+        acc = _mm256_or_si256(acc, _mm256_or_si256(
+            _mm256_or_si256(_mm256_loadu_si256(v + 4), _mm256_loadu_si256(v + 5)),
+            _mm256_or_si256(_mm256_loadu_si256(v + 6), _mm256_loadu_si256(v + 7))));
+
+        if (!_mm256_testz_si256(acc, acc)) return false;
+    }
+    return true;
+} // page_is_zero_avx2()
+
+__attribute__((target("sse2")))
+static bool page_is_zero_sse2(const unsigned char* p) {
+    const __m128i zero = _mm_setzero_si128();
+
+    for (size_t i = 0; i < VM_PAGESIZE; i += 128) {
+        auto v = reinterpret_cast<const __m128i*>(p + i);
+        __m128i acc = _mm_or_si128(
+            _mm_or_si128(_mm_loadu_si128(v + 0), _mm_loadu_si128(v + 1)),
+            _mm_or_si128(_mm_loadu_si128(v + 2), _mm_loadu_si128(v + 3)));
+        acc = _mm_or_si128(acc, _mm_or_si128(
+            _mm_or_si128(_mm_loadu_si128(v + 4), _mm_loadu_si128(v + 5)),
+            _mm_or_si128(_mm_loadu_si128(v + 6), _mm_loadu_si128(v + 7))));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xFFFF) return false;
+    }
+    return true;
+} // page_is_zero_sse2()
+#endif
+
+static bool page_is_zero_scalar(const unsigned char* p) {
+    for (size_t i = 0; i < VM_PAGESIZE; i += 64) {
+        uint64_t w[8];
+        std::memcpy(w, p + i, sizeof(w));
+
+        if ((w[0] | w[1] | w[2] | w[3] | w[4] | w[5] | w[6] | w[7]) != 0) return false;
+    }
+    return true;
+} // page_is_zero_scalar()
+
+bool page_is_zero(const void* page) {
+    auto p = static_cast<const unsigned char*>(page);
+
+#if defined(__x86_64__) || defined(__i386__)
+    // picked once, the pager may be built without -mavx2
+    static const int kernel = __builtin_cpu_supports("avx2") ? 2 : __builtin_cpu_supports("sse2") ? 1 : 0;
+
+    if (kernel == 2) return page_is_zero_avx2(p);
+    if (kernel == 1) return page_is_zero_sse2(p);
+#endif
+    return page_is_zero_scalar(p);
+} // page_is_zero()
+
 void set_pte_bits(page_table_entry_t &pte,
                 int ppage_,     
                 int read_enable_,      
@@ -221,6 +645,98 @@ void set_pte_bits(page_table_entry_t &pte,
     pte.referenced      = referenced_ >= 0 ? referenced_ : pte.referenced;
 } // set_pte_bits()
 
+unsigned int rmap_insert(rmap_list_t &list, pid_t pid, unsigned int vpn) {
+    unsigned int node;
+
+    // recycle a free node if we have one
+    if (rmap_free != RMAP_NIL) {
+        node = rmap_free;
+        rmap_free = rmap_pool[node].next;
+    }
+    else {
+        node = static_cast<unsigned int>(rmap_pool.size());
+        rmap_pool.emplace_back();
+    }
+
+    auto &entry = rmap_pool[node];
+    entry.pid = pid;
+    entry.vpn = vpn;
+    entry.prev = RMAP_NIL;
+    entry.next = list.head;
+
+    if (list.head != RMAP_NIL) {
+        rmap_pool[list.head].prev = node;
+    }
+    list.head = node;
+    ++list.size;
+
+    return node;
+} // rmap_insert()
+
+void rmap_unlink(rmap_list_t &list, unsigned int node) {
+    auto &entry = rmap_pool[node];
+
+    if (entry.prev != RMAP_NIL) {
+        rmap_pool[entry.prev].next = entry.next;
+    }
+    else {
+        list.head = entry.next;
+    }
+    if (entry.next != RMAP_NIL) {
+        rmap_pool[entry.next].prev = entry.prev;
+    }
+    --list.size;
+
+    // push onto the free list
+    entry.prev = RMAP_NIL;
+    entry.next = rmap_free;
+    rmap_free = node;
+} // rmap_unlink()
+
+void frame_rmap_add(unsigned int ppn, pid_t pid, unsigned int vpn) {
+    process_map[pid].rmap[vpn].frame_node = rmap_insert(frame_info[ppn].ptes, pid, vpn);
+} // frame_rmap_add()
+
+void frame_rmap_remove(unsigned int ppn, pid_t pid, unsigned int vpn) {
+    auto &pcb = process_map[pid];
+    auto &handle = pcb.rmap[vpn].frame_node;
+
+    if (handle == RMAP_NIL) return;
+
+    // the page is handled on its own from here on
+    superpage_split(ppn);
+
+    // keep the pte's reference / dirty state now that it no longer points here
+    auto &pte = pcb.page_table[vpn];
+    if (pte.referenced) frame_table[ppn].ref = 1;
+    if (pte.dirty) frame_table[ppn].dirty = 1;
+
+    rmap_unlink(frame_info[ppn].ptes, handle);
+    handle = RMAP_NIL;
+} // frame_rmap_remove()
+
+void file_rmap_add(fcb_t &fcb, pid_t pid, unsigned int vpn) {
+    process_map[pid].rmap[vpn].file_node = rmap_insert(fcb.ptes, pid, vpn);
+} // file_rmap_add()
+
+void file_rmap_remove(fcb_t &fcb, pid_t pid, unsigned int vpn) {
+    auto &handle = process_map[pid].rmap[vpn].file_node;
+
+    if (handle == RMAP_NIL) return;
+
+    rmap_unlink(fcb.ptes, handle);
+    handle = RMAP_NIL;
+} // file_rmap_remove()
+
+unsigned int intern_file(const std::string &path) {
+    auto [it, added] = file_ids.try_emplace(path, static_cast<unsigned int>(file_names.size()));
+
+    if (added) {
+        file_names.push_back(path);
+    }
+    return it->second;
+} // intern_file()
+
 bool read_string_from_va(const char *filename_va, std::string &output) {
 
     auto raw_virtual_addr = reinterpret_cast<uintptr_t>(filename_va);
@@ -252,106 +768,377 @@ bool read_string_from_va(const char *filename_va, std::string &output) {
     }
 } // read_string_from_va()
 
-unsigned int evict() {
-    std::shared_ptr<phys_page_t> page;
+// Takes ppn off drop_behind_frames, if it is on it
+static void drop_behind_remove(unsigned int ppn) {
+    if (!frame_table[ppn].drop_behind) return;
+
+    drop_behind_frames.erase(frame_info[ppn].drop_node);
+    frame_table[ppn].drop_behind = 0;
+} // drop_behind_remove()
+
+// The next drop-behind frame nobody used since it was queued, taken from the replacement policy -- 0 if none
+static unsigned int drop_behind_victim() {
+    while (!drop_behind_frames.empty()) {
+        unsigned int ppn = drop_behind_frames.front();
+        drop_behind_remove(ppn);
+
+        // touched again after the stream moved on, or written again after being freed:
+        // the policy decides about it after all
+        auto &page = frame_table[ppn];
+        bool used = false;
+        for (unsigned int n = frame_info[ppn].ptes.head; n != RMAP_NIL; n = rmap_pool[n].next) {
+            auto &pte = process_map[rmap_pool[n].pid].page_table[rmap_pool[n].vpn];
+            if (page.lazy_free ? pte.dirty : pte.referenced) used = true;
+        }
+        if (used) {
+            page.lazy_free = 0;
+            continue;
+        }
 
+        replacement_policy->frame_removed(ppn);
+        return ppn;
+    }
+    return 0;
+} // drop_behind_victim()
+
+// evict() once the victim is chosen and taken from the replacement policy
+static unsigned int evict_frame(unsigned int ppn) {
     // print_page_map();
+    bool written = true;
 
-    // Update reference and dirty bit of physical page from associated pte's
-    update_reference_bits();
+    superpage_split(ppn);
 
-    // std::cout << "Clock size: " << clock_queue.size() << std::endl;
+    frame_table[ppn].tracked = 0;
+    --tracked_frames;
 
-    // Run clock algorithm, update pte's associated with physical page
-    size_t n = clock_queue.size();
-    for(size_t i = 0; i < n+1; ++i){
-        page = clock_queue.front();
+    // The writeback below needs every pte's dirty bit folded in
+    harvest_reference_bits(ppn);
 
-        // assert(page->block != -1);
+    auto &page = frame_table[ppn];
+    auto &info = frame_info[ppn];
 
-        clock_queue.pop();
-        clock_queue.push(page);
+    // std::cout << "Eviciting " << ppn << '\n'; 
 
-        // std::cout << "\n Page ppn: " << page->ppn << '\n';
-        if(page->ref == 0){
-            
-            // std::cout << "\n ref==0 \n";
-            page->ref = 1;
+    // print_page_map();
 
-            break;
-        }      
-        
-        // std::cout << "\n ref==1 \n";
-        
-        page->ref = 0;
+    // Freed and not written since: the contents are disposable, the slot just reads as zeros again
+    if (page.lazy_free && page.dirty == 0) {
+        swap_mark_zero(page.block);
+    }
 
-        // Update reference bits of PTEs to 0 if associated with physical page
-        auto phys_page = page;
+    // WRITE BACK if dirty -- usually the cleaner got here first and this is free
+    if (page.dirty != 0){
+        if (page.file_backed == 0 && info.ptes.head != RMAP_NIL) {
+            written = writeback_swap_run(ppn);
+        }
+        else {
+            written = writeback_frame(ppn);
+        }
+    }
 
-        size_t n = phys_page->ptes.size();
-        for (size_t i = 0; i < n; i++) {
-            auto pair = phys_page->ptes.front();
-            phys_page->ptes.pop();
-            phys_page->ptes.push(pair);
+    // Overcommitted and the swap file is full: the page stays where it is, tracked again
+    if (!written) {
+        page.tracked = 1;
+        ++tracked_frames;
+        replacement_policy->frame_added(ppn);
+        return 0;
+    }
+
+    // Erase ppn mapping to block of filename after eviction, and the fcb itself if nobody maps
+    // the block (read ahead and never faulted on, or cached after its last mapper left)
+    if(page.file_backed != 0) {
+        fcb_pool[info.fcb].ppn = 0;
+        if (fcb_pool[info.fcb].ptes.size == 0) fcb_erase(info.fcb);
+    }
 
-            auto &pte = process_map[pair.first].page_table[pair.second];
+    // A clean swap page whose slot reads as zeros holds nothing but zeros:
+    // its ptes go back to the pinned zero page, read-only, like a fresh vm_map
+    int zero_page = page.file_backed == 0 && swap_slot_zero(page.block);
 
-            pte.referenced = 0;
+    // notify all ptes with this phys_page thats its a non-resident
+    while (info.ptes.head != RMAP_NIL){
+        auto &pte = rmap_pool[info.ptes.head];
+        auto &pcb = process_map[pte.pid];
+
+        set_pte_bits(pcb.page_table[pte.vpn], 0, zero_page, 0, 0, 0);
+
+        pcb.rmap[pte.vpn].frame_node = RMAP_NIL;
+        rmap_unlink(info.ptes, info.ptes.head);
+    }
+    
+    // set page to not dirty
+    page.ref = 0;
+    page.dirty = 0;
+    page.lazy_free = 0;
+    page.file_backed = 0;
+    page.block = -1;
+    info.fcb = FCB_NIL;
+
+    return ppn;
+} // evict_frame()
+
+/*
+ * The victim ppn is part of an intact superpage: the rest of the run goes with it
+ * if none of it was used since the policy last looked, so the run of frames
+ * comes back whole. The superpage is split either way
+ */
+static void evict_superpage_rest(unsigned int ppn) {
+    unsigned int first_ppn = ppn - ppn % superpage_pages;
+    bool used = false;
+
+    for (unsigned int other = first_ppn; other < first_ppn + superpage_pages; ++other) {
+        if (other == ppn) continue;
+
+        if (frame_table[other].ref) used = true;
+        for (unsigned int n = frame_info[other].ptes.head; n != RMAP_NIL; n = rmap_pool[n].next) {
+            if (process_map[rmap_pool[n].pid].page_table[rmap_pool[n].vpn].referenced) used = true;
         }
     }
 
-    // std::cout << "Eviciting " << page->ppn << '\n'; 
+    superpage_split(ppn);
+    if (used) return;
 
-    // print_page_map();
+    for (unsigned int other = first_ppn; other < first_ppn + superpage_pages; ++other) {
+        if (other == ppn) continue;
+
+        drop_behind_remove(other);
+        replacement_policy->frame_removed(other);
+
+        // a page that cannot be written out is tracked again, as a base page
+        if (evict_frame(other) != 0) free_pool_add(other);
+    }
+} // evict_superpage_rest()
+
+unsigned int evict() {
+    // Pages a sequential stream left behind go first, otherwise the replacement policy picks the victim
+    unsigned int ppn = drop_behind_victim();
+    if (ppn == 0) {
+        ppn = replacement_policy->select_victim();
+        drop_behind_remove(ppn);
+    }
 
-    // WRITE BACK if dirty
-    if (page->dirty != 0){
-        if(page->file_backed != 0){
-            // write back to file
-            file_write(page->filename.data(), page->block, BASE_ADDR + (page->ppn * VM_PAGESIZE));
+    if (frame_table[ppn].super) evict_superpage_rest(ppn);
 
-        } else {
-            file_write(nullptr, page->block, BASE_ADDR + (page->ppn * VM_PAGESIZE));
+    return evict_frame(ppn);
+} // evict()
+
+bool spare_frame_available(unsigned int keep) {
+    while (open_phys_pages.size() <= keep) {
+        unsigned int ppn = drop_behind_victim();
+        if (ppn == 0) return false;
+
+        // a drop-behind victim that cannot be written out is tracked again, the next one is tried
+        ppn = evict_frame(ppn);
+        if (ppn != 0) free_pool_add(ppn);
+    }
+    return true;
+} // spare_frame_available()
+
+bool writeback_frame(unsigned int ppn) {
+    auto &page = frame_table[ppn];
+    auto &info = frame_info[ppn];
 
+    // dirty again after VM_ADVICE_FREE, the new contents are kept
+    page.lazy_free = 0;
+
+    if(page.file_backed != 0){
+        // write back to file
+        file_write(file_names[fcb_pool[info.fcb].file].c_str(), page.block, BASE_ADDR + (ppn * VM_PAGESIZE));
+
+    } else if (page_is_zero(BASE_ADDR + (ppn * VM_PAGESIZE))) {
+        // nothing worth writing, the slot goes back to reading as zeros and gives up its block
+        swap_mark_zero(page.block);
+
+    } else if (zswap_store(page.block, BASE_ADDR + (ppn * VM_PAGESIZE))) {
+        // kept compressed in memory, it reaches the swap file only if the cache spills it
+        swap_mark_written(page.block);
+
+    } else {
+        // first time on disk: bind a block next to the neighbouring vpn's
+        int hint = -1;
+        if (info.ptes.head != RMAP_NIL) {
+            hint = swap_hint(process_map[rmap_pool[info.ptes.head].pid], rmap_pool[info.ptes.head].vpn);
         }
+
+        int block = swap_slot_block(page.block, hint);
+        if (block == -1) return false;
+
+        file_write(nullptr, block, BASE_ADDR + (ppn * VM_PAGESIZE));
+
+        // from now on the slot has to be read back
+        swap_mark_written(page.block);
     }
-    // Erase ppn mapping to block of filename after eviction
-    if(page->file_backed != 0) file_backed_pages[page->filename].block_to_file[page->block].ppn = 0;
 
-    // notify all ptes with this phys_page thats its a non-resident
-    while (!page->ptes.empty()){
-        auto &pte = page->ptes.front();
+    // the copy on disk is current again, later writes set the pte dirty bits anew
+    page.dirty = 0;
+    for (unsigned int n = info.ptes.head; n != RMAP_NIL; n = rmap_pool[n].next) {
+        process_map[rmap_pool[n].pid].page_table[rmap_pool[n].vpn].dirty = 0;
+    }
+    return true;
+} // writeback_frame()
+
+bool writeback_swap_run(unsigned int ppn) {
+    auto &owner = rmap_pool[frame_info[ppn].ptes.head];
+    auto &pcb = process_map[owner.pid];
+    int block = swap_slots[frame_table[ppn].block].block;
+
+    // not on disk yet, it is placed next to its neighbours when it gets there
+    if (block == -1) return writeback_frame(ppn);
+
+    // resident, dirty frame holding vpn's page in the given block (or about to get it), 0 otherwise
+    auto dirty_neighbour = [&](long vpn, long want_block) -> unsigned int {
+        if (vpn < 0 || vpn >= static_cast<long>(pcb.next_vm_page)) return 0;
+        if (pcb.rmap[vpn].frame_node == RMAP_NIL) return 0;
+
+        unsigned int n = pcb.page_table[vpn].ppage;
+        auto &page = frame_table[n];
+        if (page.file_backed) return 0;
+
+        int has = swap_slots[page.block].block;
+        if (has != want_block && !(has == -1 && swap_block_free(static_cast<int>(want_block)))) return 0;
 
-        page_table_entry_t &entry = process_map[pte.first].page_table[pte.second];
+        for (unsigned int i = frame_info[n].ptes.head; i != RMAP_NIL; i = rmap_pool[i].next) {
+            if (process_map[rmap_pool[i].pid].page_table[rmap_pool[i].vpn].dirty) page.dirty = 1;
+        }
+        return page.dirty ? n : 0;
+    };
+
+    // grow the run of dirty neighbours that sit in adjacent blocks, both ways
+    long lo = 0;
+    while (lo + 1 < static_cast<long>(SWAP_RUN) && dirty_neighbour(owner.vpn - lo - 1, block - lo - 1)) ++lo;
+    long hi = 0;
+    while (lo + hi + 1 < static_cast<long>(SWAP_RUN) && dirty_neighbour(owner.vpn + hi + 1, block + hi + 1)) ++hi;
+
+    // issue the whole run in block order, the victim's outcome is the run's
+    bool written = true;
+    for (long k = -lo; k <= hi; ++k) {
+        if (k == 0) {
+            written = writeback_frame(ppn);
+        }
+        else {
+            writeback_frame(pcb.page_table[owner.vpn + k].ppage);
+        }
+    }
+    return written;
+} // writeback_swap_run()
+
+void clean_dirty_frames() {
+    if (MAX_PHYS_PAGES < 2) return;
+
+    unsigned int usable = MAX_PHYS_PAGES - 1;
+    unsigned int low = std::max(1u, usable / 8);
+    unsigned int high = std::max(low + 1, usable / 4);
+
+    // plenty of free frames, evictions will not need to write anything
+    if (open_phys_pages.size() >= low) return;
+
+    unsigned int clean = static_cast<unsigned int>(open_phys_pages.size());
+
+    // at most one revolution, stop once the clean pool is back up to the high watermark
+    for (unsigned int scanned = 0; scanned < usable && clean < high; ++scanned) {
+        cleaner_hand = cleaner_hand % usable + 1;
+
+        auto &page = frame_table[cleaner_hand];
+        if (!page.tracked) continue;
 
-        set_pte_bits(entry, 0, 0, 0, 0, 0);
+        // fold the dirty bits but leave the reference bits to the replacement policy
+        int referenced = page.ref;
+        for (unsigned int n = frame_info[cleaner_hand].ptes.head; n != RMAP_NIL; n = rmap_pool[n].next) {
+            auto &pte = process_map[rmap_pool[n].pid].page_table[rmap_pool[n].vpn];
 
-        page->ptes.pop();
+            if (pte.dirty) page.dirty = 1;
+            if (pte.referenced) referenced = 1;
+        }
+
+        // recently used frames are likely to be written again, they are not worth the I/O yet
+        if (referenced) continue;
+
+        // no block to put it in, eviction will skip it too
+        if (page.dirty && !writeback_frame(cleaner_hand)) continue;
+        ++clean;
     }
-    
-    // set page to not dirty
-    page->ref = 0;
-    page->dirty = 0;
-    page->file_backed = 0;
-    page->block = -1;
-    page->filename = "";
+} // clean_dirty_frames()
 
-    return page->ppn;
-} // evict()
+bool reclaim_frames(unsigned int target) {
+    unsigned int failed = 0;
+
+    // consecutive victims keep the policy's hand moving, so this is one sweep,
+    // and once as many victims as there are frames could not be written out there is nothing left to try
+    while (open_phys_pages.size() < target && tracked_frames > failed) {
+        unsigned int ppn = evict();
+
+        if (ppn == 0) {
+            ++failed;
+        }
+        else {
+            free_pool_add(ppn);
+        }
+    }
+
+    return open_phys_pages.size() >= target;
+} // reclaim_frames()
 
 unsigned int get_next_ppn() {
-    if(open_phys_pages.empty()){
-        return evict();
-    }         
+    // vm_fault reclaimed what the fault needs up front, so this only fails if that was skipped --
+    // nothing is evicted here, the handler calling this may be halfway through changing a frame
+    assert(!open_phys_pages.empty());
     
-    unsigned int page = *open_phys_pages.begin();
-    open_phys_pages.erase(page);
-
-    clock_queue.push(page_map[page]);
+    unsigned int page = free_pool_take();
 
+    // the frame is handed to the replacement policy once it holds a page (install_frame)
     return page;
 } // get_next_ppn()
 
+file_info_t& disk_table_t::mut(unsigned int vpn) {
+    auto &chunk = chunks[vpn / DISK_CHUNK];
+
+    // still shared with a parent or child (or never written): this process gets its own copy
+    if (!chunk) {
+        chunk = std::make_shared<disk_chunk_t>();
+    }
+    else if (chunk.use_count() > 1) {
+        chunk = std::make_shared<disk_chunk_t>(*chunk);
+    }
+    return chunk->entries[vpn % DISK_CHUNK];
+} // disk_table_t::mut()
+
+void install_frame(unsigned int ppn, int file_backed, int block, unsigned int fcb, int ref) {
+    auto &page = frame_table[ppn];
+
+    page.file_backed = file_backed;
+    page.block = block;
+    page.ref = ref;
+    page.dirty = 0;
+    page.lazy_free = 0;
+    frame_info[ppn].fcb = fcb;
+
+    page.tracked = 1;
+    ++tracked_frames;
+    replacement_policy->frame_added(ppn);
+} // install_frame()
+
+void release_frame(unsigned int ppn) {
+    auto &page = frame_table[ppn];
+
+    free_pool_add(ppn);
+
+    superpage_split(ppn);
+    drop_behind_remove(ppn);
+
+    if (page.tracked) {
+        page.tracked = 0;
+        --tracked_frames;
+        replacement_policy->frame_removed(ppn);
+    }
+
+    page.ref = 0;
+    page.dirty = 0;
+    page.lazy_free = 0;
+    page.file_backed = 0;
+    page.block = -1;
+    frame_info[ppn].fcb = FCB_NIL;
+} // release_frame()
+
 char* virtual_to_phys(const char* virtual_addr) {
     auto raw_virtual_addr = reinterpret_cast<uintptr_t>(virtual_addr);
     
@@ -381,54 +1168,28 @@ char* virtual_to_phys(const char* virtual_addr) {
 } // virtual_to_phys()
 
 /*
- * DEBUGGING: Print out contents of page_map
+ * DEBUGGING: Print out contents of the frame table
  */
 void print_page_map() {
-    std::shared_ptr<phys_page_t> page;
-
-    // print clock queue
-    unsigned int n = clock_queue.size();
-
-    if (n > 0) {
-        std::cout << "FRONT OF CLOCK QUEUE: " << clock_queue.front()->ppn << '\n';
-    }
-    for(size_t i = 0; i < n; ++i){
-        page = clock_queue.front();
-
-        // assert(page->block != -1);
-
-        clock_queue.pop();
-        clock_queue.push(page);
-
-        std::cout << "PPN: " << page->ppn << "\n"
-                << "  ref: " << page->ref << "\n"
-                << "  dirty: " << page->dirty << "\n"
-                << "  file_backed: " << page->file_backed << "\n"
-                << "  block: " << page->block << "\n"
-                << "  filename: " << page->filename << "\n";
-    }
+    std::cout << "REPLACEMENT POLICY: " << replacement_policy->name() << '\n';
 
     std::cout << "--------------------------------------\n";
     std::cout << "--------------------------------------\n";
     std::cout << "--------------------------------------\n";
 
-    for (const auto &entry : page_map) {
-        unsigned int ppn = entry.first;
-        const auto &page = entry.second;
+    for (unsigned int ppn = 1; ppn < MAX_PHYS_PAGES; ++ppn) {
+        const auto &page = frame_table[ppn];
+        auto &info = frame_info[ppn];
         std::cout << "PPN: " << ppn << "\n"
-                << "  ref: " << page->ref << "\n"
-                << "  dirty: " << page->dirty << "\n"
-                << "  file_backed: " << page->file_backed << "\n"
-                << "  block: " << page->block << "\n"
-                << "  filename: " << page->filename << "\n"
+                << "  ref: " << page.ref << "\n"
+                << "  dirty: " << page.dirty << "\n"
+                << "  file_backed: " << page.file_backed << "\n"
+                << "  block: " << page.block << "\n"
+                << "  filename: " << (info.fcb == FCB_NIL ? "" : file_names[fcb_pool[info.fcb].file]) << "\n"
                 << "  ptes:\n";
 
-        size_t qsize = page->ptes.size();
-        for (size_t i = 0; i < qsize; ++i) {
-            auto p = page->ptes.front();
-            std::cout << "    (pid: " << p.first << ", vpn: " << p.second << ")\n";
-            page->ptes.pop();
-            page->ptes.push(p); // restore order
+        for (unsigned int n = info.ptes.head; n != RMAP_NIL; n = rmap_pool[n].next) {
+            std::cout << "    (pid: " << rmap_pool[n].pid << ", vpn: " << rmap_pool[n].vpn << ")\n";
         }
 
         std::cout << "--------------------------------------\n";
@@ -436,60 +1197,99 @@ void print_page_map() {
 
 }
 
-void update_reference_bits() {
+void harvest_reference_bits(unsigned int ppn) {
+    auto &phys_page = frame_table[ppn];
+    auto &ptes = frame_info[ppn].ptes;
+
     // UPDATE REFERENCED & DIRTY BITS TO REFLECT PTE's
-    for (size_t p = 1; p < MAX_PHYS_PAGES; p++) {
-        auto &phys_page = page_map[p];
+    for (unsigned int n = ptes.head; n != RMAP_NIL; n = rmap_pool[n].next) {
+        auto &pte = process_map[rmap_pool[n].pid].page_table[rmap_pool[n].vpn];
 
-        size_t n = phys_page->ptes.size();
+        if (pte.referenced) {
+            phys_page.ref = 1;
+            pte.referenced = 0;
+        }
+        if (pte.dirty) {
+            phys_page.dirty = 1;
+        }
+    }
+} // harvest_reference_bits()
 
-        bool dirty = false;
-        bool ref = false;
+void check_states() {
+    // Compare state of ptes in each physicsl pahe align
+        assert(open_phys_pages.find(0) == open_phys_pages.end());
 
-        for (size_t i = 0; i < n; i++) {
-            auto pair = phys_page->ptes.front();
-            phys_page->ptes.pop();
-            phys_page->ptes.push(pair);
+        unsigned int tracked = 0;
+        for (unsigned int ppn = 1; ppn < MAX_PHYS_PAGES; ++ppn) {
+            if (frame_table[ppn].tracked) ++tracked;
+        }
+        assert(tracked == tracked_frames);
 
-            auto &pte = process_map[pair.first].page_table[pair.second];
+        // free frames are neither tracked by the replacement policy nor mapped
+        // (a frame being filled mid-fault is neither free nor tracked yet)
+        for (auto ppn: open_phys_pages) {
+            assert(!frame_table[ppn].tracked);
+            assert(frame_info[ppn].ptes.size == 0);
+        }
 
-            if (pte.referenced) {
-                phys_page->ref = 1;
-                ref = true;
-            }
-            if (pte.dirty) {
-                phys_page->dirty = 1;
-                dirty = true;
-            }
-            if (dirty && ref) {
-                break;
+        // free_in_run counts the free pool by run of superpage_pages frames
+        std::vector<unsigned int> free_count(free_in_run.size(), 0);
+        for (auto ppn: open_phys_pages) ++free_count[ppn / superpage_pages];
+        assert(free_count == free_in_run);
+
+        // an intact superpage is a whole run of tracked frames
+        for (unsigned int ppn = 1; ppn < MAX_PHYS_PAGES; ++ppn) {
+            if (!frame_table[ppn].super) continue;
+
+            unsigned int first_ppn = ppn - ppn % superpage_pages;
+            assert(superpage_pages > 1 && first_ppn + superpage_pages <= MAX_PHYS_PAGES);
+            for (unsigned int other = first_ppn; other < first_ppn + superpage_pages; ++other) {
+                assert(frame_table[other].super && frame_table[other].tracked);
             }
         }
-    }
-}
 
-void check_states() {
-    // Compare state of ptes in each physicsl pahe align
-        assert(open_phys_pages.find(0) == open_phys_pages.end());
+        // drop-behind frames are resident and still tracked until reclaim takes them
+        for (auto ppn: drop_behind_frames) {
+            assert(frame_table[ppn].drop_behind);
+            assert(frame_table[ppn].tracked);
+        }
 
         for(auto &[pid, pcb]: process_map){
+            // free ranges are unmapped, below next_vm_page and never touch each other or next_vm_page
+            unsigned int free_end = 0;
+            for (auto &[start, length] : pcb.free_vpns) {
+                assert(length > 0 && (start > free_end || start == 0) && start + length < pcb.next_vm_page);
+                for (unsigned int v = start; v < start + length; ++v) {
+                    assert(!pcb.pages_on_disk[v].valid);
+                }
+                free_end = start + length;
+            }
+
             for (size_t i = 0; i < pcb.next_vm_page; ++i){
 
                 auto &file_info = pcb.pages_on_disk[i];
                 auto &pte = pcb.page_table[i];
 
+                // unmapped by vm_unmap: no pte bits and on no reverse map
+                if (!file_info.valid) {
+                    assert(pte.read_enable == 0 && pte.write_enable == 0 && pte.ppage == 0);
+                    assert(pcb.rmap[i].frame_node == RMAP_NIL && pcb.rmap[i].file_node == RMAP_NIL);
+                    continue;
+                }
+
                 if (file_info.file_backed){
-                    assert(file_info.filename != "");
+                    assert(fcb_pool[file_info.fcb].file < file_names.size());
+                    assert(fcb_pool[file_info.fcb].block == static_cast<unsigned int>(file_info.block));
                 } else {
                     // swap backed file
-                    if (swap_file[file_info.block].size() > 1){
+                    if (swap_sharer_count(file_info.block) > 1){
                         // std::cout << "Pid: " << pid  << ", vpn: " << i << ", pte.ppage: " 
                         // << pte.ppage << ", file_info.block: " << file_info.block << std::endl;
 
                         assert(pte.write_enable == 0);
                     }
 
-                    if (swap_file[file_info.block].size() == 1 && pte.ppage != 0 && file_info.valid && pte.read_enable) {
+                    if (swap_sharer_count(file_info.block) == 1 && pte.ppage != 0 && file_info.valid && pte.read_enable) {
                         assert(pte.write_enable == 1);
                     }
 
@@ -498,66 +1298,70 @@ void check_states() {
             }
         }
 
-        // file_backed_pages
-        for (auto &[filename, map]: file_backed_pages) {
-            for (auto &[block, fcb]: map.block_to_file) {
-
-                int n = fcb.ptes.size();
-                if(fcb.ppn != 0){
-                    assert(fcb.ptes.size() == page_map[fcb.ppn]->ptes.size());
-                 }
-                for (int i = 0; i < n; i++){
-                    auto pair = fcb.ptes.front();
-                    fcb.ptes.pop();
-                    fcb.ptes.push(pair);
-                    auto &pte = process_map[pair.first].page_table[pair.second];
-                    if (fcb.ppn == 0){
-                        assert(pte.read_enable == 0);
-                    }
-                    if(pte.read_enable){
-                        assert(pte.ppage == fcb.ppn);
-                    }
-    
+        // fcb_pool
+        for (unsigned int handle = 0; handle < fcb_pool.size(); ++handle) {
+            auto &fcb = fcb_pool[handle];
+            if (fcb.file == FILE_NONE) continue;
+
+            assert(fcb_find(fcb.file, fcb.block) == handle);
+
+            // an fcb nobody maps lives only as long as its block is resident
+            assert(fcb.ppn != 0 || fcb.ptes.size > 0);
+
+            if(fcb.ppn != 0){
+                assert(fcb.ptes.size == frame_info[fcb.ppn].ptes.size);
+             }
+            for (unsigned int n = fcb.ptes.head; n != RMAP_NIL; n = rmap_pool[n].next){
+                auto &node = rmap_pool[n];
+                assert(process_map[node.pid].rmap[node.vpn].file_node == n);
+                auto &pte = process_map[node.pid].page_table[node.vpn];
+                if (fcb.ppn == 0){
+                    assert(pte.read_enable == 0);
+                }
+                if(pte.read_enable){
+                    assert(pte.ppage == fcb.ppn);
                 }
+
             }
         }
 
         for (size_t p = 1; p < MAX_PHYS_PAGES; p++) {
-            auto &phys_page = page_map[p];
+            auto &phys_page = frame_table[p];
+            auto &ptes = frame_info[p].ptes;
 
-            size_t n = phys_page->ptes.size();
+            size_t n = ptes.size;
 
             if ( n > 0 ){
-                assert(phys_page->block != -1);
+                assert(phys_page.block != -1);
             }
 
-            if(n == 0 && !phys_page->file_backed){
-                assert(phys_page->block == -1);
+            if(n == 0 && !phys_page.file_backed){
+                assert(phys_page.block == -1);
             }
             
 
-            if(!phys_page->file_backed){
-                assert(phys_page->filename == "");
+            if(!phys_page.file_backed){
+                assert(frame_info[p].fcb == FCB_NIL);
             }
 
-            for (size_t i = 0; i < n; i++) {
-                auto pair = phys_page->ptes.front();
-                phys_page->ptes.pop();
-                phys_page->ptes.push(pair);
+            for (unsigned int i = ptes.head; i != RMAP_NIL; i = rmap_pool[i].next) {
+                auto &node = rmap_pool[i];
 
-                auto &file_info = process_map[pair.first].pages_on_disk[pair.second];
-                auto &pte = process_map[pair.first].page_table[pair.second];
+                auto &file_info = process_map[node.pid].pages_on_disk[node.vpn];
+                auto &pte = process_map[node.pid].page_table[node.vpn];
 
-                assert(phys_page->file_backed == file_info.file_backed);
-                assert(phys_page->ppn == pte.ppage);
-                assert(process_map[pair.first].pages_on_disk[pair.second].block == phys_page->block);
+                assert(process_map[node.pid].rmap[node.vpn].frame_node == i);
+                assert(phys_page.file_backed == file_info.file_backed);
+                assert(phys_page.ppn == pte.ppage);
+                assert(process_map[node.pid].pages_on_disk[node.vpn].block == phys_page.block);
                 if(!file_info.file_backed){
-                    assert(open_swap_pages.find(file_info.block) == open_swap_pages.end());
+                    assert(swap_sharer_has(file_info.block, node.pid));
+                    assert(swap_slots[file_info.block].block == -1 || !swap_block_free(swap_slots[file_info.block].block));
                 }
 
-                if (phys_page->file_backed && pte.read_enable){
+                if (phys_page.file_backed && pte.read_enable){
                     assert(pte.ppage != 0);
-                    assert(phys_page->block != -1);
+                    assert(phys_page.block != -1);
                 }
             }
     }
@@ -565,19 +1369,12 @@ void check_states() {
 
 void print_file_backed_pages() {
     // for each pte a fileback data structue, make a entry fot the child as well
-    for (auto &[filename, map]: file_backed_pages) {
-        for (auto &[block, fcb]: map.block_to_file) {
-
-            int n = fcb.ptes.size();
-            for (int i = 0; i < n; i++){
+    for (auto &fcb: fcb_pool) {
+        if (fcb.file == FILE_NONE) continue;
 
-                auto pair = fcb.ptes.front();
-                fcb.ptes.pop();
-                fcb.ptes.push(pair);
-
-                std::cout << "(filename, block): " << filename << ", " << block
-                    << " ---> (pid, vpn): " << pair.first << ", " << pair.second << '\n';
-            }
+        for (unsigned int n = fcb.ptes.head; n != RMAP_NIL; n = rmap_pool[n].next){
+            std::cout << "(filename, block): " << file_names[fcb.file] << ", " << fcb.block
+                << " ---> (pid, vpn): " << rmap_pool[n].pid << ", " << rmap_pool[n].vpn << '\n';
         }
     }
 }
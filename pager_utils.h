@@ -18,6 +18,41 @@ void set_pte_bits(page_table_entry_t &pte,
                     int referenced_);
 //
 
+/*
+ * Clears a whole page, used instead of copying frame 0 or reading a swap
+ * block that was never written
+ */
+void zero_fill_page(void* page);
+
+/*
+ * true if the page is all zeros -- AVX2 or SSE2 picked at runtime, scalar
+ * elsewhere. Dirty swap victims are checked before their writeback.
+ */
+bool page_is_zero(const void* page);
+
+/*
+ * Links (pid, vpn) onto a reverse map, returns the node handle
+ */
+unsigned int rmap_insert(rmap_list_t &list, pid_t pid, unsigned int vpn);
+
+/*
+ * Unlinks a node from a reverse map and recycles it
+ */
+void rmap_unlink(rmap_list_t &list, unsigned int node);
+
+/*
+ * Adds / removes (pid, vpn) on the reverse map of a physical page
+ * and keeps the pcb's handle in sync
+ */
+void frame_rmap_add(unsigned int ppn, pid_t pid, unsigned int vpn);
+void frame_rmap_remove(unsigned int ppn, pid_t pid, unsigned int vpn);
+
+/*
+ * Adds / removes (pid, vpn) on the reverse map of a file block
+ */
+void file_rmap_add(fcb_t &fcb, pid_t pid, unsigned int vpn);
+void file_rmap_remove(fcb_t &fcb, pid_t pid, unsigned int vpn);
+
 /*
  * Takes in a pointer to the file name, copies the string 
  * 
@@ -27,19 +62,80 @@ void set_pte_bits(page_table_entry_t &pte,
 bool read_string_from_va(const char* filename_va, std::string& output);
 
 /*
-* Performs the Clock Eviction LRU Algorithm 
-* Returns the PPN of the page to be replaced
+ * Id of path in the file table, added the first time the path is seen
+ */
+unsigned int intern_file(const std::string &path);
+
+/*
+* Evicts the oldest drop-behind frame that was not used again since it was
+* queued, or else the page chosen by the replacement policy, writing it back if dirty.
+* A victim in an intact superpage takes the rest of the run into the free pool
+* with it when none of it was used recently
+* Returns the PPN of the page to be replaced, 0 if the page could not be
+* written back (swap file full under overcommit) and stays resident
 */
 unsigned int evict();
 
+/*
+ * Frames for readahead and prefetch, taken without evicting the working set:
+ * true once more than keep frames are free, reclaiming drop-behind frames
+ * (and nothing else) to get there
+ */
+bool spare_frame_available(unsigned int keep);
+
+/*
+ * Writes a dirty frame back to its file / swap slot and clears the dirty
+ * bits of the frame and of every pte mapping it
+ * Returns false, leaving the frame dirty, if its slot needs a block and the swap file is full
+ */
+bool writeback_frame(unsigned int ppn);
+
+/*
+ * Writes back a dirty swap-backed victim together with the dirty resident
+ * pages of its owner's neighbouring vpns that sit in the adjacent swap blocks,
+ * as one run in block order (at most SWAP_RUN blocks)
+ * Returns writeback_frame()'s result for the victim
+ */
+bool writeback_swap_run(unsigned int ppn);
+
+/*
+ * Write-behind cleaner, run off the fault path (vm_switch)
+ * 
+ * Once the free pool drops below its low watermark, writes back dirty frames
+ * that were not referenced recently until free + clean frames reach the high
+ * watermark, so the policy's victims can usually be dropped without any I/O
+ */
+void clean_dirty_frames();
+
+/*
+ * Batch reclaim: evicts pages into the free pool until target frames are
+ * free, so the policy's sweep and the writebacks are paid once per batch
+ * instead of once per fault. Victims that cannot be written back are passed over.
+ * Returns false if target could not be reached
+ */
+bool reclaim_frames(unsigned int target);
+
 /*
 * Wrapper function to get the next available physical page
 * 
-* If the next open physical page is larger than max number of phys pages
-* Return the evicted page 
+* Only takes from the free pool, never evicts: vm_fault runs the watermark
+* reclaim and frees the frames the fault takes before its handler starts,
+* readahead and prefetch check for a spare frame first
 */
 unsigned int get_next_ppn();
 
+/*
+ * Records the page a frame from get_next_ppn() now holds
+ * and hands the frame to the replacement policy
+ */
+void install_frame(unsigned int ppn, int file_backed, int block, unsigned int fcb, int ref);
+
+/*
+ * Returns a frame no longer mapped by anyone to the free pool
+ * and takes it away from the replacement policy
+ */
+void release_frame(unsigned int ppn);
+
 /*
  * Translates a virtual address into a physical address
  * 
@@ -48,37 +144,134 @@ unsigned int get_next_ppn();
 char* virtual_to_phys(const char* virtual_addr);
 
 /*
- * DEBUGGING: Print out contents of page_map
+ * DEBUGGING: Print out contents of the frame table
  */
 void print_page_map();
 
 /*
- * Update reference bits in page_map to align with PTE's
+ * Fold the referenced and dirty bits of every pte mapping ppn into the
+ * frame, clearing the ptes' referenced bits. Called as the replacement policy
+ * visits a frame, so each eviction only pays for the frames it passes.
  */
-void update_reference_bits();
+void harvest_reference_bits(unsigned int ppn);
 
 // assert states of physical pages and ptes match
 void check_states();
 
 /*
- * Print data in our file_backed_pages data structure
+ * Print data in our fcb_pool
  */
 void print_file_backed_pages();
 
 // file_backed_fault
-int file_backed_fault(page_table_entry_t &pte, file_info_t &disk_info, unsigned int next_page,
+int file_backed_fault(page_table_entry_t &pte, const file_info_t &disk_info, unsigned int next_page,
     void* destination, unsigned int vpn);
 
-// swap_block_reservation
-void swap_block_reservation(int & block);
+/*
+ * Sequential readahead after a file-backed fault at (file, block), mapped at vpn
+ * 
+ * Detects the current process's stream over file and, while it stays
+ * sequential, reads the following blocks into free frames with a window
+ * that doubles per fault, so a scan mostly finds its pages resident.
+ * vpn's advice overrides the detection: sequential starts at the largest
+ * window, random reads nothing ahead
+ */
+void file_readahead(unsigned int file, unsigned int block, unsigned int vpn);
+
+/*
+ * Reads the block of a non-resident fcb into a free frame and maps it to
+ * everyone who mapped the block. false, with the frame given back, if the
+ * block cannot be read (past the end of the file)
+ */
+bool file_block_prefetch(unsigned int handle);
+
+/*
+ * file_block_prefetch() into the frame ppn, already taken from the free pool
+ * -- false, with ppn left as it was, if the block cannot be read
+ */
+bool file_block_fill(unsigned int handle, unsigned int ppn);
+
+/*
+ * Releases what the current process's page at vpn holds: its place on its
+ * frame's reverse map (freeing a swap-backed frame nobody else maps), its
+ * swap slot sharer entry (freeing the slot with its last sharer) or fcb
+ * reverse-map entry, and its pte bits. pages_on_disk is left to the caller
+ */
+void release_page(unsigned int vpn);
+
+/*
+ * Free vpn ranges of a process (pcb.free_vpns, below next_vm_page):
+ *  >> vpn_range_find: lowest vpn starting count unmapped pages, NUM_VPAGES if none
+ *  >> vpn_range_take: marks a range vpn_range_find returned as mapped
+ *  >> vpn_range_free: gives a mapped range back, merging it with its neighbours
+ *     (or lowering next_vm_page if it reaches it)
+ */
+unsigned int vpn_range_find(const pcb_t &pcb, unsigned int count);
+void vpn_range_take(pcb_t &pcb, unsigned int vpn, unsigned int count);
+void vpn_range_free(pcb_t &pcb, unsigned int vpn, unsigned int count);
+
+// swap_block_reservation: gives vpn of the current process a private slot, returned
+int swap_block_reservation(unsigned int vpn);
+
+/*
+ * true if pte maps a resident swap-backed frame that nobody else maps and whose
+ * slot has no other sharer, so a write fault can upgrade it instead of copying
+ */
+bool sole_swap_owner(const page_table_entry_t &pte, const file_info_t &disk_info);
 
 // swap_back_fault_in_memory
-int swap_back_fault_in_memory(page_table_entry_t &pte, file_info_t &disk_info, unsigned int vpn);
+int swap_back_fault_in_memory(page_table_entry_t &pte, const file_info_t &disk_info, unsigned int vpn);
 
 // swap_back_disk
-int swap_back_disk(page_table_entry_t &pte, file_info_t &disk_info, unsigned int next_page,
+int swap_back_disk(page_table_entry_t &pte, const file_info_t &disk_info, unsigned int next_page,
     void* destination, bool write_flag, unsigned int vpn);
 
+/*
+ * Swap-in readahead after a fault on vpn of the current process: the
+ * following private, non-resident pages whose blocks continue vpn's run on
+ * disk are read into free frames (at most SWAP_RUN - 1 of them), none if
+ * vpn is advised random
+ */
+void swap_readahead(unsigned int vpn);
+
+/*
+ * Reads the non-resident swap page at vpn of the current process into a free
+ * frame and maps it to every sharer of its slot, as a read fault would.
+ * false, with the frame given back, if the read fails
+ */
+bool swap_page_prefetch(unsigned int vpn);
+
+/*
+ * swap_page_prefetch() into the frame ppn, already taken from the free pool
+ * -- false, with ppn left as it was, if the read fails
+ */
+bool swap_page_fill(unsigned int vpn, unsigned int ppn);
+
+/*
+ * VM_ADVICE_WILLNEED: brings the non-resident pages [vpn, vpn + count) of
+ * the current process in ahead of their faults. Only free frames above the
+ * reclaim low watermark and drop-behind frames are used, so the advice never
+ * evicts the working set
+ */
+void willneed_prefetch(unsigned int vpn, unsigned int count);
+
+/*
+ * VM_ADVICE_FREE on [vpn, vpn + count) of the current process (swap-backed
+ * pages only). A private resident page is queued on drop_behind_frames with
+ * its frame marked clean and lazy_free: reclaim drops it without writing it,
+ * unless it was written again first. A page that is not resident reads as
+ * zeros at once, and a copy-on-write sharer moves to a fresh zero slot
+ */
+void discard_pages(unsigned int vpn, unsigned int count);
+
+/*
+ * Fault at vpn under VM_ADVICE_SEQUENTIAL: queues the frames of the resident
+ * sequential pages behind vpn on drop_behind_frames, so reclaim takes them
+ * before the replacement policy's victims. Stops at the first page that is
+ * not resident or already queued, so each page is visited once
+ */
+void drop_behind(unsigned int vpn);
+
 // copy_on_write_disk
-void copy_on_write_disk(page_table_entry_t &pte, file_info_t &disk_info, unsigned int next_page,
+void copy_on_write_disk(page_table_entry_t &pte, const file_info_t &disk_info, unsigned int next_page,
     void* destination, bool write_flag, unsigned int vpn);
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "pager_zswap.h"
+#include "pager_swap.h"
+
+size_t zswap_limit = 0;
+
+namespace {
+
+/*
+ * zswap_entry_t:
+ *
+ * One cached swap slot: its compressed bytes and its place on the LRU
+ */
+struct zswap_entry_t {
+    std::vector<uint8_t> data;
+    std::list<int>::iterator lru;
+};
+
+std::unordered_map<int, zswap_entry_t> zswap_entries;
+std::list<int> zswap_lru;               // most recently used first
+size_t zswap_bytes = 0;
+
+constexpr unsigned int LZ_HASH_BITS = 12;
+constexpr size_t LZ_MIN_MATCH = 4;
+constexpr size_t LZ_MAX_OFFSET = 0xFFFF;
+
+uint32_t load32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// length in the 4 bit nibble plus 255-byte continuation bytes, false if out of room
+bool put_length(uint8_t* dst, size_t &op, size_t cap, size_t len) {
+    while (len >= 255) {
+        if (op >= cap) return false;
+        dst[op++] = 255;
+        len -= 255;
+    }
+    if (op >= cap) return false;
+    dst[op++] = static_cast<uint8_t>(len);
+    return true;
+}
+
+bool get_length(const uint8_t* src, size_t &ip, size_t len_in, size_t &len) {
+    uint8_t b;
+    do {
+        if (ip >= len_in) return false;
+        b = src[ip++];
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+// one sequence: literals [lit, lit + lit_len), then a match unless match_len is 0
+bool put_sequence(uint8_t* dst, size_t &op, size_t cap, const uint8_t* lit, size_t lit_len,
+    size_t offset, size_t match_len) {
+
+    size_t m = match_len ? match_len - LZ_MIN_MATCH : 0;
+
+    if (op >= cap) return false;
+    dst[op++] = static_cast<uint8_t>((std::min<size_t>(lit_len, 15) << 4) | std::min<size_t>(m, 15));
+
+    if (lit_len >= 15 && !put_length(dst, op, cap, lit_len - 15)) return false;
+
+    if (op + lit_len > cap) return false;
+    std::memcpy(dst + op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len == 0) return true;
+
+    if (op + 2 > cap) return false;
+    dst[op++] = static_cast<uint8_t>(offset);
+    dst[op++] = static_cast<uint8_t>(offset >> 8);
+
+    return m < 15 || put_length(dst, op, cap, m - 15);
+}
+
+// Writes the least recently used entry to its slot's swap block, through a free frame
+// false, with the entry still cached, if no frame is free, the slot has no block and the
+// swap file is full, or the write fails
+bool zswap_spill() {
+    // file_write only takes buffers in physical memory; a free frame holds nothing and
+    // nothing runs while the pager does, so it can lend itself for the write
+    if (open_phys_pages.empty()) return false;
+    uint8_t* buffer = BASE_ADDR + static_cast<size_t>(*open_phys_pages.begin()) * VM_PAGESIZE;
+
+    int slot = zswap_lru.back();
+    auto &entry = zswap_entries[slot];
+
+    int block = swap_slot_block(slot, -1);
+    if (block == -1) return false;
+
+    if (!lz_decompress(entry.data.data(), entry.data.size(), buffer, VM_PAGESIZE)) return false;
+    if (file_write(nullptr, block, buffer) == -1) return false;
+
+    zswap_drop(slot);
+    return true;
+}
+
+} // namespace
+
+size_t lz_compress(const uint8_t* src, size_t n, uint8_t* dst, size_t cap) {
+    uint32_t table[1u << LZ_HASH_BITS] = {};     // position + 1 of the last 4 bytes with that hash
+    size_t ip = 0;
+    size_t anchor = 0;
+    size_t op = 0;
+    size_t misses = 0;
+
+    while (ip + LZ_MIN_MATCH <= n) {
+        uint32_t seq = load32(src + ip);
+        uint32_t h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t ref = table[h];
+        table[h] = static_cast<uint32_t>(ip + 1);
+
+        if (ref == 0 || ip - (ref - 1) > LZ_MAX_OFFSET || load32(src + ref - 1) != seq) {
+            // skip faster through data that does not compress
+            ip += 1 + (misses++ >> 5);
+            continue;
+        }
+        misses = 0;
+
+        size_t match = ref - 1;
+        size_t len = LZ_MIN_MATCH;
+
+        // extend 8 bytes at a time, the first differing byte is the lowest set bit of the xor (little endian)
+        while (ip + len + 8 <= n) {
+            uint64_t a, b;
+            std::memcpy(&a, src + match + len, 8);
+            std::memcpy(&b, src + ip + len, 8);
+            if (a != b) {
+                len += static_cast<size_t>(__builtin_ctzll(a ^ b)) / 8;
+                break;
+            }
+            len += 8;
+        }
+        if (ip + len + 8 > n) {
+            while (ip + len < n && src[match + len] == src[ip + len]) ++len;
+        }
+
+        if (!put_sequence(dst, op, cap, src + anchor, ip - anchor, ip - match, len)) return 0;
+
+        ip += len;
+        anchor = ip;
+    }
+
+    // trailing literals, no match
+    if (!put_sequence(dst, op, cap, src + anchor, n - anchor, 0, 0)) return 0;
+
+    return op;
+} // lz_compress()
+
+bool lz_decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t n) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < len) {
+        uint8_t token = src[ip++];
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !get_length(src, ip, len, lit_len)) return false;
+
+        if (ip + lit_len > len || op + lit_len > n) return false;
+        std::memcpy(dst + op, src + ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+
+        // the last sequence has no match
+        if (ip == len) break;
+
+        if (ip + 2 > len) return false;
+        size_t offset = src[ip] | (static_cast<size_t>(src[ip + 1]) << 8);
+        ip += 2;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && !get_length(src, ip, len, match_len)) return false;
+        match_len += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > op || op + match_len > n) return false;
+
+        // the match may overlap what it produces: copy it offset bytes at a time
+        while (match_len > 0) {
+            size_t chunk = std::min(offset, match_len);
+            std::memcpy(dst + op, dst + op - offset, chunk);
+            op += chunk;
+            match_len -= chunk;
+        }
+    }
+
+    return op == n;
+} // lz_decompress()
+
+bool zswap_store(int slot, const void* page) {
+    // the old copy is stale whatever happens next
+    zswap_drop(slot);
+
+    if (zswap_limit == 0) return false;
+
+    static uint8_t scratch[VM_PAGESIZE];
+    size_t size = lz_compress(static_cast<const uint8_t*>(page), VM_PAGESIZE, scratch, VM_PAGESIZE / 4 * 3);
+
+    // incompressible, or bigger than the whole pool
+    if (size == 0 || size > zswap_limit) return false;
+
+    while (zswap_bytes + size > zswap_limit) {
+        if (!zswap_spill()) return false;
+    }
+
+    zswap_lru.push_front(slot);
+
+    auto &entry = zswap_entries[slot];
+    entry.data.assign(scratch, scratch + size);
+    entry.lru = zswap_lru.begin();
+    zswap_bytes += size;
+
+    return true;
+} // zswap_store()
+
+bool zswap_load(int slot, void* page) {
+    auto it = zswap_entries.find(slot);
+    if (it == zswap_entries.end()) return false;
+
+    auto &entry = it->second;
+
+    zswap_lru.splice(zswap_lru.begin(), zswap_lru, entry.lru);
+
+    return lz_decompress(entry.data.data(), entry.data.size(), static_cast<uint8_t*>(page), VM_PAGESIZE);
+} // zswap_load()
+
+void zswap_drop(int slot) {
+    auto it = zswap_entries.find(slot);
+    if (it == zswap_entries.end()) return;
+
+    zswap_bytes -= it->second.data.size();
+    zswap_lru.erase(it->second.lru);
+    zswap_entries.erase(it);
+} // zswap_drop()
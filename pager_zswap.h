@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pager.h"
+
+/***************************************************************************************************
+ *                                     Compressed Swap Cache                                       *
+ ***************************************************************************************************/
+
+/*
+ * zswap:
+ *
+ * Compressed copies of swap slots kept in the pager's own memory, between
+ * writeback_frame() / the swap-in paths and the swap file. A swap-backed page
+ * that is written back is compressed into the cache instead of being written;
+ * a fault on its slot decompresses it instead of calling file_read. The
+ * entry stays after a swap-in, so the frame can be dropped again for free
+ * while it is clean -- a dirty frame replaces it on its next writeback.
+ *
+ * The pool is bounded by zswap_limit bytes of compressed data. Past that, the
+ * least recently used entries are written out to their slots' swap blocks
+ * (bound then if need be) through a free frame; with no frame free, a full
+ * swap file or a failed write the entry stays cached and the store fails.
+ * Pages that do not compress to 3/4 of a page go straight to the swap file.
+ *
+ * zswap_limit comes from VM_ZSWAP_PAGES (read in vm_init), in pages' worth of
+ * bytes: 0, the cache off, if unset.
+ */
+extern size_t zswap_limit;
+
+/*
+ * In-tree LZ77 compressor (LZ4-style sequences: literal run, 16-bit offset,
+ * match length). Returns the compressed size, 0 if it would not fit in cap.
+ */
+size_t lz_compress(const uint8_t* src, size_t n, uint8_t* dst, size_t cap);
+
+/*
+ * Inverse of lz_compress, true if src decodes to exactly n bytes
+ */
+bool lz_decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t n);
+
+/*
+ * Compresses the page into the cache as the contents of slot
+ * Returns false (and forgets any older copy) if the cache is off, the page
+ * does not compress well enough or no room can be spilled -- the caller writes it then
+ */
+bool zswap_store(int slot, const void* page);
+
+/*
+ * Decompresses slot's cached copy into page
+ * Returns false if slot is not cached
+ */
+bool zswap_load(int slot, void* page);
+
+/*
+ * Forgets slot's cached copy, if any
+ */
+void zswap_drop(int slot);
@@ -99,6 +99,56 @@ void vm_destroy();
  */
 void* vm_map(const char* filename, unsigned int block);
 
+/*
+ * vm_map_range
+ *
+ * Like count calls to vm_map in a row, in one call: declares the lowest
+ * count invalid virtual pages valid and returns the lowest address of the
+ * first one.  If filename is nullptr the pages are backed by the swap file,
+ * otherwise page i is backed by block first_block + i of filename (which is
+ * read once).  Either every page is mapped or none is: vm_map_range returns
+ * nullptr if count is 0, or if any of the count pages could not be mapped
+ * for the reasons vm_map gives.
+ */
+void* vm_map_range(const char* filename, unsigned int first_block, unsigned int count);
+
+/*
+ * vm_advise
+ *
+ * Pager-internal: not in vm_app.h, the application library has no entry
+ * point that forwards it.  A hint about how the current process will access
+ * the virtual pages overlapping [addr, addr + len).  VM_ADVICE_SEQUENTIAL and
+ * VM_ADVICE_RANDOM set the pages' access pattern until it is advised again
+ * (VM_ADVICE_NORMAL restores the default); VM_ADVICE_WILLNEED asks for the
+ * pages to be brought into free physical pages now, ahead of their faults.
+ * VM_ADVICE_FREE declares the contents of the range's swap-backed pages
+ * disposable: until a page is written again, the pager may drop it instead
+ * of writing it to the swap file, and it then reads as all zeroes (file-backed
+ * pages are left alone).  No other advice changes the pages' contents.
+ * Returns 0 on success, -1 if the advice is unknown or any page of the range
+ * is not valid.
+ */
+enum vm_advice_t : unsigned int {
+    VM_ADVICE_NORMAL = 0,
+    VM_ADVICE_SEQUENTIAL = 1,
+    VM_ADVICE_RANDOM = 2,
+    VM_ADVICE_WILLNEED = 3,
+    VM_ADVICE_FREE = 4
+};
+
+int vm_advise(const void* addr, size_t len, vm_advice_t advice);
+
+/*
+ * vm_unmap
+ *
+ * Declares the npages virtual pages starting at the page-aligned address
+ * addr invalid again, releasing whatever the pager holds for them.  Later
+ * calls to vm_map may hand the pages out again.  Returns 0 on success, -1
+ * if addr is not page aligned, npages is 0, or any page of the range is not
+ * valid (in which case nothing is unmapped).
+ */
+int vm_unmap(const void* addr, unsigned int npages);
+
 /*
  * file_read
  *